@@ -0,0 +1,173 @@
+#include "bench.h"
+
+#include "platform.h"
+#include "string_builder.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define BENCH_CYCLE_COUNTER
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+
+INTERNAL u64 volatile BenchSink;
+
+void bench_keep(u64 value) {
+    BenchSink += value;
+}
+
+INTERNAL u64 read_cycle_counter() {
+#ifdef BENCH_CYCLE_COUNTER
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+void init(BenchSuite *suite, Allocator alloc) {
+    INIT_STRUCT(suite);
+    suite->warmup      = 2;
+    suite->repetitions = 10;
+    suite->min_time_ms = 10.0;
+
+    init(&suite->results, 0, alloc);
+}
+
+void destroy(BenchSuite *suite) {
+    destroy(&suite->results);
+}
+
+struct BenchSample {
+    s64 time;
+    u64 cycles;
+};
+
+INTERNAL BenchSample run_repetition(BenchFunc *func, void *data, s64 iterations) {
+    BenchSample sample;
+
+    s64 start_time   = platform_timestamp();
+    u64 start_cycles = read_cycle_counter();
+
+    func(data, iterations);
+
+    sample.cycles = read_cycle_counter() - start_cycles;
+    sample.time   = platform_timestamp() - start_time;
+
+    return sample;
+}
+
+// NOTE: Insertion sort, there are only a few repetitions.
+template<class Type>
+INTERNAL void sort_samples(Type *values, s64 count) {
+    for (s64 i = 1; i < count; i += 1) {
+        Type value = values[i];
+
+        s64 j = i;
+        for (; j > 0 && values[j - 1] > value; j -= 1) {
+            values[j] = values[j - 1];
+        }
+        values[j] = value;
+    }
+}
+
+void run_benchmark(BenchSuite *suite, String name, BenchFunc *func, void *data) {
+    if (suite->filter.size && !contains(name, suite->filter)) return;
+
+    // NOTE: Doubles the iterations until a repetition is long enough to measure.
+    s64 iterations = 1;
+    for (;;) {
+        BenchSample sample = run_repetition(func, data, iterations);
+        if (platform_in_milliseconds(sample.time) >= suite->min_time_ms || iterations >= ((s64)1 << 40)) break;
+
+        iterations *= 2;
+    }
+
+    for (s32 i = 0; i < suite->warmup; i += 1) {
+        run_repetition(func, data, iterations);
+    }
+
+    s32 repetitions = suite->repetitions > 0 ? suite->repetitions : 1;
+
+    List<r64> times  = {};
+    List<u64> cycles = {};
+    init(&times, repetitions);
+    init(&cycles, repetitions);
+    DEFER(destroy(&times); destroy(&cycles));
+
+    r64 total = 0;
+    for (s32 i = 0; i < repetitions; i += 1) {
+        BenchSample sample = run_repetition(func, data, iterations);
+
+        r64 ns = platform_in_milliseconds(sample.time) * 1000000.0 / iterations;
+        append(&times, ns);
+        append(&cycles, sample.cycles);
+
+        total += ns;
+    }
+
+    sort_samples(times.data, times.size);
+    sort_samples(cycles.data, cycles.size);
+
+    BenchResult result = {};
+    result.name          = name;
+    result.iterations    = iterations;
+    result.repetitions   = repetitions;
+    result.ns_min        = times[0];
+    result.ns_median     = times[times.size / 2];
+    result.ns_mean       = total / repetitions;
+    result.cycles_median = (r64)cycles[cycles.size / 2] / iterations;
+
+    append(&suite->results, result);
+}
+
+void print_results(BenchSuite *suite) {
+    print("\n%D benchmarks\n", suite->results.size);
+
+    FOR (suite->results, result) {
+        print("%S\n    median %f ns, min %f ns, mean %f ns, median %f cycles (%D iterations x %D)\n", result->name, result->ns_median, result->ns_min, result->ns_mean, result->cycles_median, result->iterations, result->repetitions);
+    }
+}
+
+INTERNAL b32 write_report(StringBuilder *builder, String file_name) {
+    PlatformFile file = platform_file_open(file_name, PlatformFileOverride);
+    if (!file.open) return false;
+
+    b32 written = write_builder_to_file(builder, &file);
+    platform_file_close(&file);
+
+    return written;
+}
+
+b32 write_csv(BenchSuite *suite, String file_name) {
+    StringBuilder builder;
+    init(&builder);
+    DEFER(destroy(&builder));
+
+    append(&builder, "name,iterations,repetitions,ns_min,ns_median,ns_mean,cycles_median\n");
+    FOR (suite->results, result) {
+        format(&builder, "%S,%D,%D,%f,%f,%f,%f\n", result->name, result->iterations, result->repetitions, result->ns_min, result->ns_median, result->ns_mean, result->cycles_median);
+    }
+
+    return write_report(&builder, file_name);
+}
+
+// NOTE: Names are written as they are, they are our own and never need escaping.
+b32 write_json(BenchSuite *suite, String file_name) {
+    StringBuilder builder;
+    init(&builder);
+    DEFER(destroy(&builder));
+
+    append(&builder, "{\n    \"benchmarks\": [\n");
+    FOR (suite->results, result) {
+        format(&builder, "        {\"name\": \"%S\", \"iterations\": %D, \"repetitions\": %D, \"ns_min\": %f, \"ns_median\": %f, \"ns_mean\": %f, \"cycles_median\": %f}",
+               result->name, result->iterations, result->repetitions, result->ns_min, result->ns_median, result->ns_mean, result->cycles_median);
+
+        append(&builder, result + 1 < end(suite->results) ? ",\n" : "\n");
+    }
+    append(&builder, "    ]\n}\n");
+
+    return write_report(&builder, file_name);
+}
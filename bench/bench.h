@@ -0,0 +1,58 @@
+//================================================
+// A small benchmark harness. A benchmark is a
+// function that runs its workload iterations times.
+// The harness first finds an iteration count that
+// takes at least min_time_ms, runs warmup
+// repetitions that are thrown away and then measures
+// the repetitions. Every result is per iteration,
+// in nanoseconds and, on x86, in cycles of the time
+// stamp counter.
+//
+// Results are printed as a table and can be written
+// as CSV or JSON, to compare a change against the
+// numbers of the commit before it.
+//================================================
+#pragma once
+
+#include "definitions.h"
+#include "list.h"
+#include "string2.h"
+
+
+typedef void BenchFunc(void *data, s64 iterations);
+
+struct BenchResult {
+    String name;
+
+    s64 iterations;  // NOTE: Per repetition.
+    s64 repetitions;
+
+    // NOTE: Per iteration.
+    r64 ns_min;
+    r64 ns_median;
+    r64 ns_mean;
+    r64 cycles_median; // NOTE: 0 if there is no cycle counter.
+};
+
+struct BenchSuite {
+    s32 warmup;
+    s32 repetitions;
+    r64 min_time_ms;
+
+    String filter; // NOTE: Only benchmarks with this in their name run, empty runs all.
+
+    List<BenchResult> results;
+};
+
+void init(BenchSuite *suite, Allocator alloc = DefaultAllocator);
+void destroy(BenchSuite *suite);
+
+// NOTE: The name has to outlive the suite.
+void run_benchmark(BenchSuite *suite, String name, BenchFunc *func, void *data);
+
+void print_results(BenchSuite *suite);
+b32  write_csv (BenchSuite *suite, String file_name);
+b32  write_json(BenchSuite *suite, String file_name);
+
+// NOTE: Keeps the compiler from optimizing away results that are otherwise unused.
+void bench_keep(u64 value);
@@ -0,0 +1,1052 @@
+//================================================
+// The benchmarks of the core library. Run without
+// arguments to get all of them, the options are:
+//
+//   --filter <text>       only benchmarks with text in the name
+//   --repetitions <n>     measured repetitions, default 10
+//   --warmup <n>          repetitions thrown away first, default 2
+//   --min-time <ms>       minimum duration of one repetition, default 10
+//   --csv <file>          write the results as CSV
+//   --json <file>         write the results as JSON
+//   --font <file>         a ttf file for the glyph benchmarks and checks
+//
+// Before the benchmarks run, the SSE2 string
+// primitives are compared against plain byte loops
+// on random inputs, random schema tables are
+// written and read back and random TextBuffer edits
+// are repeated on a flat string. With a font the
+// distance fields of its glyphs are compared with
+// the ones of stb_truetype. The run fails if any
+// of the checks fails.
+//
+// Config parsing writes its input file into the
+// current folder and deletes it afterwards.
+//================================================
+#include "bench.h"
+
+#include "platform.h"
+#include "hash_table.h"
+#include "string_builder.h"
+#include "utf.h"
+#include "config.h"
+#include "font.h"
+#include "schema.h"
+#include "text_buffer.h"
+
+
+s64 const BenchItems = 4096;
+s64 const BenchTextSize = KILOBYTES(64);
+
+INTERNAL u64 next_random(u64 *state) {
+    // NOTE: xorshift64, only needs to be the same on every run.
+    u64 x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+
+    return x;
+}
+
+struct BenchData {
+    u64 keys[BenchItems];
+    HashTable<u64, u64> table;
+
+    String ascii_text;  // NOTE: Printable ASCII with line breaks.
+    String mixed_text;  // NOTE: About a third multi byte sequences.
+    String16 mixed_text16;
+    String16 conversion_buffer16;
+    String   conversion_buffer8;
+
+    String config_file;
+    String font_file;
+    Font font;
+    b32 has_font;
+};
+
+
+//===============================================
+// Containers
+//===============================================
+INTERNAL void bench_hash_table_insert(void *data, s64 iterations) {
+    BenchData *bench = (BenchData*)data;
+
+    for (s64 i = 0; i < iterations; i += 1) {
+        HashTable<u64, u64> table = {};
+        init(&table, 4);
+
+        for (s64 k = 0; k < BenchItems; k += 1) {
+            insert(&table, bench->keys[k], (u64)k);
+        }
+
+        bench_keep(table.used);
+        destroy(&table);
+    }
+}
+
+INTERNAL void bench_hash_table_find(void *data, s64 iterations) {
+    BenchData *bench = (BenchData*)data;
+
+    for (s64 i = 0; i < iterations; i += 1) {
+        u64 sum = 0;
+        for (s64 k = 0; k < BenchItems; k += 1) {
+            sum += *find(&bench->table, bench->keys[k]);
+        }
+
+        bench_keep(sum);
+    }
+}
+
+INTERNAL void bench_hash_table_miss(void *data, s64 iterations) {
+    BenchData *bench = (BenchData*)data;
+
+    for (s64 i = 0; i < iterations; i += 1) {
+        u64 found = 0;
+        for (s64 k = 0; k < BenchItems; k += 1) {
+            if (find(&bench->table, bench->keys[k] + 1)) found += 1;
+        }
+
+        bench_keep(found);
+    }
+}
+
+INTERNAL void bench_list_append(void *data, s64 iterations) {
+    for (s64 i = 0; i < iterations; i += 1) {
+        List<s64> list = {};
+        init(&list, 0);
+
+        for (s64 k = 0; k < BenchItems; k += 1) {
+            append(&list, k);
+        }
+
+        bench_keep(list.size);
+        destroy(&list);
+    }
+}
+
+INTERNAL void bench_string_builder_append(void *data, s64 iterations) {
+    StringBuilder builder;
+    init(&builder);
+    DEFER(destroy(&builder));
+
+    for (s64 i = 0; i < iterations; i += 1) {
+        reset(&builder);
+
+        for (s64 k = 0; k < BenchItems; k += 1) {
+            append(&builder, "some text ");
+            append(&builder, (u8)'\n');
+        }
+
+        bench_keep(builder.total_size);
+    }
+}
+
+
+//===============================================
+// Formatting
+//===============================================
+INTERNAL void bench_format(void *data, s64 iterations) {
+    StringBuilder builder;
+    init(&builder);
+    DEFER(destroy(&builder));
+
+    for (s64 i = 0; i < iterations; i += 1) {
+        reset(&builder);
+
+        for (s32 k = 0; k < 256; k += 1) {
+            format(&builder, "%d: %S = %D (%f)\n", k, String("value"), (s64)k * 1000003, k * 0.25);
+        }
+
+        bench_keep(builder.total_size);
+    }
+}
+
+// NOTE: The same path as print, but into a file so the output stays readable.
+INTERNAL void bench_print(void *data, s64 iterations) {
+    PlatformFile file = platform_file_open("bench_print.txt", PlatformFileOverride);
+    if (!file.open) return;
+
+    for (s64 i = 0; i < iterations; i += 1) {
+        for (s32 k = 0; k < 256; k += 1) {
+            format(&file, "%d: %S = %D (%f)\n", k, String("value"), (s64)k * 1000003, k * 0.25);
+        }
+    }
+
+    platform_file_close(&file);
+    platform_delete_file("bench_print.txt");
+}
+
+
+//===============================================
+// Text
+//===============================================
+INTERNAL void bench_utf8_to_utf16(void *data, s64 iterations) {
+    BenchData *bench = (BenchData*)data;
+
+    for (s64 i = 0; i < iterations; i += 1) {
+        UTFResult result = to_utf16(bench->conversion_buffer16, bench->mixed_text);
+        bench_keep(result);
+    }
+}
+
+INTERNAL void bench_utf16_to_utf8(void *data, s64 iterations) {
+    BenchData *bench = (BenchData*)data;
+
+    for (s64 i = 0; i < iterations; i += 1) {
+        UTFResult result = to_utf8(bench->conversion_buffer8, bench->mixed_text16);
+        bench_keep(result);
+    }
+}
+
+INTERNAL void bench_utf8_decode(void *data, s64 iterations) {
+    BenchData *bench = (BenchData*)data;
+    u32 codepoints[UTF8DecodeBlockSize];
+
+    for (s64 i = 0; i < iterations; i += 1) {
+        String text = bench->mixed_text;
+        u64 sum = 0;
+
+        while (text.size) {
+            UTF8DecodeResult block = decode_utf8_block(text, codepoints, UTF8DecodeBlockSize);
+            sum += block.count;
+
+            if (block.status != UTF_OK) break;
+            text = shrink_front(text, block.bytes);
+        }
+
+        bench_keep(sum);
+    }
+}
+
+INTERNAL void bench_utf8_length(void *data, s64 iterations) {
+    BenchData *bench = (BenchData*)data;
+
+    for (s64 i = 0; i < iterations; i += 1) {
+        bench_keep(utf8_string_length(bench->mixed_text));
+    }
+}
+
+INTERNAL void bench_find_byte(void *data, s64 iterations) {
+    BenchData *bench = (BenchData*)data;
+
+    for (s64 i = 0; i < iterations; i += 1) {
+        bench_keep(find_first(bench->ascii_text, '~'));
+    }
+}
+
+INTERNAL void bench_find_string(void *data, s64 iterations) {
+    BenchData *bench = (BenchData*)data;
+
+    for (s64 i = 0; i < iterations; i += 1) {
+        bench_keep(find_first(bench->ascii_text, String("needle")));
+    }
+}
+
+INTERNAL void bench_next_line(void *data, s64 iterations) {
+    BenchData *bench = (BenchData*)data;
+
+    for (s64 i = 0; i < iterations; i += 1) {
+        s64 offset = 0;
+        s64 lines  = 0;
+
+        while (offset < bench->ascii_text.size) {
+            next_line(bench->ascii_text, &offset);
+            lines += 1;
+        }
+
+        bench_keep(lines);
+    }
+}
+
+INTERNAL void bench_equal(void *data, s64 iterations) {
+    BenchData *bench = (BenchData*)data;
+    String copy = allocate_string(bench->ascii_text);
+    DEFER(destroy(&copy));
+
+    for (s64 i = 0; i < iterations; i += 1) {
+        bench_keep(equal(bench->ascii_text, copy));
+    }
+}
+
+
+//===============================================
+// String primitives against the plain byte loops.
+// The SSE2 paths in string2.h have to agree with
+// these for every length and alignment, the check
+// compares them on random inputs before the
+// benchmarks run. The scalar benchmarks give the
+// speedup of the SSE2 paths.
+//===============================================
+INTERNAL s64 scalar_find_first(String str, u8 c) {
+    for (s64 i = 0; i < str.size; i += 1) {
+        if (str.data[i] == c) return i;
+    }
+
+    return -1;
+}
+
+INTERNAL s64 scalar_find_first_of(String str, u8 a, u8 b) {
+    for (s64 i = 0; i < str.size; i += 1) {
+        if (str.data[i] == a || str.data[i] == b) return i;
+    }
+
+    return -1;
+}
+
+INTERNAL s64 scalar_find_last(String str, u8 c) {
+    for (s64 i = str.size; i > 0; i -= 1) {
+        if (str.data[i - 1] == c) return i - 1;
+    }
+
+    return -1;
+}
+
+INTERNAL b32 scalar_equal(String lhs, String rhs) {
+    if (lhs.size != rhs.size) return false;
+
+    for (s64 i = 0; i < lhs.size; i += 1) {
+        if (lhs.data[i] != rhs.data[i]) return false;
+    }
+
+    return true;
+}
+
+INTERNAL b32 scalar_caseless_equal(String lhs, String rhs) {
+    if (lhs.size != rhs.size) return false;
+
+    for (s64 i = 0; i < lhs.size; i += 1) {
+        if (lower_char(lhs.data[i]) != lower_char(rhs.data[i])) return false;
+    }
+
+    return true;
+}
+
+INTERNAL s64 scalar_find_first(String str, String search) {
+    for (s64 i = 0; i + search.size <= str.size; i += 1) {
+        if (scalar_equal({str.data + i, search.size}, search)) return i;
+    }
+
+    return -1;
+}
+
+// NOTE: The ByteSet lookups against a loop over the delimiters.
+INTERNAL s64 scalar_find_first_of(String str, String delimiters, b32 negate) {
+    for (s64 i = 0; i < str.size; i += 1) {
+        if (is_any(str.data[i], delimiters) != negate) return i;
+    }
+
+    return -1;
+}
+
+INTERNAL void fill_random(u64 *random, u8 *bytes, s64 size) {
+    // NOTE: Mostly a small alphabet so searches hit, sometimes any byte to cover the signed compares.
+    String alphabet = "abcABCxyzXYZ@[`{\n\r";
+
+    for (s64 i = 0; i < size; i += 1) {
+        u64 r = next_random(random);
+        bytes[i] = (r & 7) == 0 ? (u8)(r >> 8) : alphabet[(s64)((r >> 8) % alphabet.size)];
+    }
+}
+
+struct BenchCheck {
+    s64 checks;
+    s64 failures;
+};
+
+INTERNAL void check(BenchCheck *state, b32 ok, char const *name, s64 size, s64 alignment) {
+    state->checks += 1;
+    if (ok) return;
+
+    if (state->failures < 10) print("%s differs from the byte loop at size %D, alignment %D.\n", name, size, alignment);
+    state->failures += 1;
+}
+
+INTERNAL void check(BenchCheck *state, b32 ok, char const *name, s64 round) {
+    state->checks += 1;
+    if (ok) return;
+
+    if (state->failures < 10) print("%s failed in round %D.\n", name, round);
+    state->failures += 1;
+}
+
+INTERNAL b32 check_string_primitives(u64 *random) {
+    s64 const MaxSize = 64;
+    s64 const Rounds  = 8;
+
+    u8 buffer[MaxSize + 16];
+    u8 other [MaxSize + 16];
+    u8 lower [MaxSize + 16];
+
+    BenchCheck state = {};
+
+    for (s64 alignment = 0; alignment < 16; alignment += 1) {
+        for (s64 size = 0; size <= MaxSize; size += 1) {
+            for (s64 round = 0; round < Rounds; round += 1) {
+                fill_random(random, buffer, C_ARRAY_SIZE(buffer));
+                String str = {buffer + alignment, size};
+
+                u8 a = (u8)next_random(random);
+                u8 b = str.size ? str[(s64)(next_random(random) % str.size)] : 'a';
+
+                check(&state, find_first(str, b)       == scalar_find_first(str, b),       "find_first(byte)", size, alignment);
+                check(&state, find_first(str, a)       == scalar_find_first(str, a),       "find_first(byte)", size, alignment);
+                check(&state, find_last(str, b)        == scalar_find_last(str, b),        "find_last",        size, alignment);
+                check(&state, find_last(str, a)        == scalar_find_last(str, a),        "find_last",        size, alignment);
+                check(&state, find_first_of(str, a, b) == scalar_find_first_of(str, a, b), "find_first_of",    size, alignment);
+
+                // NOTE: Either a piece of str, so it is found, or random bytes that mostly aren't.
+                s64 search_size = (s64)(next_random(random) % 7);
+                if (search_size > size) search_size = size;
+
+                String search = {};
+                if (round & 1) {
+                    s64 start = (s64)(next_random(random) % (size - search_size + 1));
+                    search = {str.data + start, search_size};
+                } else {
+                    fill_random(random, other, search_size);
+                    search = {other, search_size};
+                }
+                check(&state, find_first(str, search) == scalar_find_first(str, search), "find_first(string)", size, alignment);
+
+                String delimiters = {other + 8, (s64)(next_random(random) % 4)};
+                fill_random(random, delimiters.data, delimiters.size);
+
+                ByteSet set = make_byte_set(delimiters);
+                check(&state, find_first_of(str, &set)     == scalar_find_first_of(str, delimiters, false), "find_first_of(ByteSet)",     size, alignment);
+                check(&state, find_first_not_of(str, &set) == scalar_find_first_of(str, delimiters, true),  "find_first_not_of(ByteSet)", size, alignment);
+
+                // NOTE: The copy sits at another alignment and differs in one byte, in its case or not at all.
+                s64 other_alignment = (s64)(next_random(random) % 16);
+                String copy = {other + other_alignment, size};
+                copy_memory(copy.data, str.data, size);
+
+                if (size && round % 4 != 0) {
+                    s64 index = (s64)(next_random(random) % size);
+                    copy.data[index] = round % 4 == 1 ? (u8)next_random(random) : (u8)(copy.data[index] ^ 32);
+                }
+
+                check(&state, equal(str, copy)          == scalar_equal(str, copy),          "equal",          size, alignment);
+                check(&state, caseless_equal(str, copy) == scalar_caseless_equal(str, copy), "caseless_equal", size, alignment);
+
+                String lowered = {lower + alignment, size};
+                copy_memory(lowered.data, str.data, size);
+                to_lower_case(lowered);
+
+                b32 lowered_ok = true;
+                for (s64 i = 0; i < size; i += 1) {
+                    if (lowered[i] != lower_char(str[i])) lowered_ok = false;
+                }
+                check(&state, lowered_ok, "to_lower_case", size, alignment);
+            }
+        }
+    }
+
+    print("String primitives: %D checks, %D failures.\n", state.checks, state.failures);
+
+    return state.failures == 0;
+}
+
+INTERNAL void bench_find_byte_scalar(void *data, s64 iterations) {
+    BenchData *bench = (BenchData*)data;
+
+    for (s64 i = 0; i < iterations; i += 1) {
+        bench_keep(scalar_find_first(bench->ascii_text, '~'));
+    }
+}
+
+INTERNAL void bench_find_last(void *data, s64 iterations) {
+    BenchData *bench = (BenchData*)data;
+
+    for (s64 i = 0; i < iterations; i += 1) {
+        bench_keep(find_last(bench->ascii_text, '~'));
+    }
+}
+
+INTERNAL void bench_find_last_scalar(void *data, s64 iterations) {
+    BenchData *bench = (BenchData*)data;
+
+    for (s64 i = 0; i < iterations; i += 1) {
+        bench_keep(scalar_find_last(bench->ascii_text, '~'));
+    }
+}
+
+INTERNAL void bench_find_string_scalar(void *data, s64 iterations) {
+    BenchData *bench = (BenchData*)data;
+
+    for (s64 i = 0; i < iterations; i += 1) {
+        bench_keep(scalar_find_first(bench->ascii_text, String("needle")));
+    }
+}
+
+INTERNAL void bench_equal_scalar(void *data, s64 iterations) {
+    BenchData *bench = (BenchData*)data;
+    String copy = allocate_string(bench->ascii_text);
+    DEFER(destroy(&copy));
+
+    for (s64 i = 0; i < iterations; i += 1) {
+        bench_keep(scalar_equal(bench->ascii_text, copy));
+    }
+}
+
+INTERNAL void bench_caseless_equal(void *data, s64 iterations) {
+    BenchData *bench = (BenchData*)data;
+    String copy = to_lower_case(allocate_string(bench->ascii_text));
+    DEFER(destroy(&copy));
+
+    for (s64 i = 0; i < iterations; i += 1) {
+        bench_keep(caseless_equal(bench->ascii_text, copy));
+    }
+}
+
+INTERNAL void bench_caseless_equal_scalar(void *data, s64 iterations) {
+    BenchData *bench = (BenchData*)data;
+    String copy = to_lower_case(allocate_string(bench->ascii_text));
+    DEFER(destroy(&copy));
+
+    for (s64 i = 0; i < iterations; i += 1) {
+        bench_keep(scalar_caseless_equal(bench->ascii_text, copy));
+    }
+}
+
+
+//===============================================
+// Schema round trips, every field kind with random
+// values, written and read back through read_table.
+//===============================================
+struct BenchPoint {
+    s32 x;
+    s32 y;
+};
+
+struct BenchRecord {
+    u8  a;
+    u16 b;
+    u32 c;
+    u64 d;
+    s8  e;
+    s16 f;
+    s32 g;
+    s64 h;
+    r32 i;
+    r64 j;
+
+    String name;
+    Array<u32> values;
+    BenchPoint origin;
+    Array<BenchPoint> points;
+};
+
+SchemaField const BenchPointFields[] = {
+    SCHEMA_FIELD(BenchPoint, x, 0),
+    SCHEMA_FIELD(BenchPoint, y, 1),
+};
+Schema const BenchPointSchema = MAKE_SCHEMA(BenchPoint, BenchPointFields);
+
+SchemaField const BenchRecordFields[] = {
+    SCHEMA_FIELD(BenchRecord, a, 0),
+    SCHEMA_FIELD(BenchRecord, b, 1),
+    SCHEMA_FIELD(BenchRecord, c, 2),
+    SCHEMA_FIELD(BenchRecord, d, 3),
+    SCHEMA_FIELD(BenchRecord, e, 4),
+    SCHEMA_FIELD(BenchRecord, f, 5),
+    SCHEMA_FIELD(BenchRecord, g, 6),
+    SCHEMA_FIELD(BenchRecord, h, 7),
+    SCHEMA_FIELD(BenchRecord, i, 8),
+    SCHEMA_FIELD(BenchRecord, j, 9),
+    SCHEMA_FIELD(BenchRecord, name, 10),
+    SCHEMA_FIELD(BenchRecord, values, 11),
+    SCHEMA_TABLE(BenchRecord, origin, 12, &BenchPointSchema),
+    SCHEMA_TABLE(BenchRecord, points, 13, &BenchPointSchema),
+};
+Schema const BenchRecordSchema = MAKE_SCHEMA(BenchRecord, BenchRecordFields);
+
+u32 const BenchSchemaIdentifier = 0x48434E42; // NOTE: "BNCH"
+
+INTERNAL b32 same_scalars(BenchRecord *lhs, BenchRecord *rhs) {
+    return lhs->a == rhs->a && lhs->b == rhs->b && lhs->c == rhs->c && lhs->d == rhs->d &&
+           lhs->e == rhs->e && lhs->f == rhs->f && lhs->g == rhs->g && lhs->h == rhs->h &&
+           lhs->i == rhs->i && lhs->j == rhs->j;
+}
+
+INTERNAL b32 same_values(Array<u32> lhs, Array<u32> rhs) {
+    if (lhs.size != rhs.size) return false;
+
+    for (s64 i = 0; i < lhs.size; i += 1) {
+        if (lhs[i] != rhs[i]) return false;
+    }
+
+    return true;
+}
+
+INTERNAL b32 same_points(Array<BenchPoint> lhs, Array<BenchPoint> rhs) {
+    if (lhs.size != rhs.size) return false;
+
+    for (s64 i = 0; i < lhs.size; i += 1) {
+        if (lhs[i].x != rhs[i].x || lhs[i].y != rhs[i].y) return false;
+    }
+
+    return true;
+}
+
+INTERNAL b32 check_schema_round_trips(u64 *random) {
+    s64 const Rounds = 256;
+
+    u8  name  [64];
+    u32 values[64];
+    BenchPoint points[16];
+
+    BenchCheck state = {};
+
+    for (s64 round = 0; round < Rounds; round += 1) {
+        BenchRecord record = {};
+        record.a = (u8)next_random(random);
+        record.b = (u16)next_random(random);
+        record.c = (u32)next_random(random);
+        record.d = next_random(random);
+        record.e = (s8)next_random(random);
+        record.f = (s16)next_random(random);
+        record.g = (s32)next_random(random);
+        record.h = (s64)next_random(random);
+        record.i = (r32)(s32)next_random(random) / 7.0f;
+        record.j = (r64)(s64)next_random(random) / 3.0;
+
+        record.name = {name, (s64)(next_random(random) % C_ARRAY_SIZE(name))};
+        fill_random(random, name, record.name.size);
+
+        record.values = {values, (s64)(next_random(random) % C_ARRAY_SIZE(values))};
+        fill_random(random, (u8*)values, record.values.size * sizeof(u32));
+
+        record.origin = {(s32)next_random(random), (s32)next_random(random)};
+
+        record.points = {points, (s64)(next_random(random) % C_ARRAY_SIZE(points))};
+        fill_random(random, (u8*)points, record.points.size * sizeof(BenchPoint));
+
+        SchemaWriter writer;
+        init(&writer, BenchSchemaIdentifier, 1);
+        finish(&writer, write_table(&writer, &BenchRecordSchema, &record));
+
+        String data = to_allocated_string(&writer.builder);
+        destroy(&writer);
+
+        SchemaBuffer buffer;
+        b32 opened = open_schema_buffer(&buffer, data, BenchSchemaIdentifier);
+        check(&state, opened, "open_schema_buffer", round);
+
+        if (opened) {
+            BenchRecord read = {};
+            read_table(&buffer.root, &BenchRecordSchema, &read);
+
+            check(&state, same_scalars(&read, &record),                        "schema scalars",     round);
+            check(&state, read.name == record.name,                            "schema string",      round);
+            check(&state, same_values(read.values, record.values),             "schema array",       round);
+            check(&state, same_points({&read.origin, 1}, {&record.origin, 1}), "schema table",       round);
+            check(&state, same_points(read.points, record.points),             "schema table array", round);
+
+            DEALLOC(DefaultAllocator, read.points.data, read.points.size);
+        }
+
+        destroy(&data);
+    }
+
+    print("Schema round trips: %D checks, %D failures.\n", state.checks, state.failures);
+
+    return state.failures == 0;
+}
+
+
+//===============================================
+// TextBuffer edits against the same edits on one
+// flat string. The inserts are sometimes bigger
+// than a piece so they get split.
+//===============================================
+INTERNAL b32 same_content(TextBuffer *buffer, List<u8> *flat, u8 *scratch) {
+    if (text_size(buffer) != flat->size) return false;
+
+    copy_range(buffer, 0, flat->size, scratch);
+    if (!equal(String(scratch, flat->size), String(flat->data, flat->size))) return false;
+
+    // NOTE: The chunks have to cover the text without gaps.
+    s64 pos = 0;
+    while (pos < flat->size) {
+        String chunk = chunk_at(buffer, pos);
+        if (chunk.size == 0 || !equal(chunk, String(flat->data + pos, chunk.size))) return false;
+
+        pos += chunk.size;
+    }
+
+    return chunk_at(buffer, pos).size == 0;
+}
+
+INTERNAL b32 same_lines(TextBuffer *buffer, List<u8> *flat, u64 *random) {
+    s64 lines = 1;
+    FOR (*flat, c) {
+        if (*c == '\n') lines += 1;
+    }
+
+    if (line_count(buffer) != lines) return false;
+
+    // NOTE: A few random lines, checking all of them would make the check quadratic.
+    for (s64 i = 0; i < 8; i += 1) {
+        s64 line = (s64)(next_random(random) % lines);
+
+        s64 start = 0;
+        for (s64 l = 0; l < line; start += 1) {
+            if (flat->data[start] == '\n') l += 1;
+        }
+
+        s64 end = start;
+        while (end < flat->size && flat->data[end] != '\n') end += 1;
+
+        String text = {flat->data + start, end - start};
+        if (text.size && text[-1] == '\r') text.size -= 1;
+
+        SCOPE_TEMP_STORAGE();
+        if (line_start(buffer, line) != start || line_end(buffer, line) != end) return false;
+        if (line_text(buffer, line) != text) return false;
+
+        s64 pos = start + (end > start ? (s64)(next_random(random) % (end - start)) : 0);
+        if (line_of(buffer, pos) != line) return false;
+    }
+
+    return true;
+}
+
+INTERNAL b32 check_text_buffer_edits(u64 *random) {
+    s64 const Edits      = 2000;
+    s64 const MaxText    = TEXT_BUFFER_MAX_PIECE * 8;
+    s64 const CheckEvery = 50;
+
+    u8 *insert_bytes = ALLOC(DefaultAllocator, u8, TEXT_BUFFER_MAX_PIECE * 2);
+    u8 *scratch      = ALLOC(DefaultAllocator, u8, MaxText + TEXT_BUFFER_MAX_PIECE * 2);
+    DEFER(DEALLOC(DefaultAllocator, insert_bytes, TEXT_BUFFER_MAX_PIECE * 2));
+    DEFER(DEALLOC(DefaultAllocator, scratch, MaxText + TEXT_BUFFER_MAX_PIECE * 2));
+
+    String original = allocate_string(TEXT_BUFFER_MAX_PIECE * 2 + 123);
+    DEFER(destroy(&original));
+    fill_random(random, original.data, original.size);
+
+    TextBuffer buffer = {};
+    init(&buffer, original);
+    DEFER(destroy(&buffer));
+
+    List<u8> flat = {};
+    init(&flat, 0);
+    DEFER(destroy(&flat));
+    insert(&flat, 0, Array<u8>{original.data, original.size});
+
+    BenchCheck state = {};
+
+    for (s64 edit = 0; edit < Edits; edit += 1) {
+        u64 r = next_random(random);
+
+        b32 inserting = flat.size < MaxText / 2 ? r % 3 != 0 : r % 3 == 0;
+        if (inserting && flat.size < MaxText) {
+            // NOTE: Mostly typing, sometimes a paste of more than a piece.
+            s64 size = (r >> 8) % 16 == 0 ? (s64)(next_random(random) % (TEXT_BUFFER_MAX_PIECE * 2)) : (s64)(next_random(random) % 16);
+            s64 pos  = (r >> 12) % 4 == 0 ? flat.size : (s64)(next_random(random) % (flat.size + 1));
+            fill_random(random, insert_bytes, size);
+
+            insert(&buffer, pos, String(insert_bytes, size));
+            insert(&flat, pos, Array<u8>{insert_bytes, size});
+        } else if (flat.size) {
+            s64 pos  = (s64)(next_random(random) % flat.size);
+            s64 size = (s64)(next_random(random) % 64);
+            if ((r >> 8) % 16 == 0) size = (s64)(next_random(random) % (TEXT_BUFFER_MAX_PIECE * 2));
+            if (size > flat.size - pos) size = flat.size - pos;
+
+            remove(&buffer, pos, size);
+            stable_remove(&flat, pos, size);
+        }
+
+        check(&state, text_size(&buffer) == flat.size, "text_size", edit);
+        if (flat.size) {
+            s64 pos = (s64)(next_random(random) % flat.size);
+            check(&state, byte_at(&buffer, pos) == flat[pos], "byte_at", edit);
+        }
+
+        if (edit % CheckEvery == CheckEvery - 1) {
+            check(&state, same_content(&buffer, &flat, scratch), "text buffer content", edit);
+            check(&state, same_lines(&buffer, &flat, random),    "text buffer lines",   edit);
+        }
+    }
+
+    print("TextBuffer edits: %D checks, %D failures.\n", state.checks, state.failures);
+
+    return state.failures == 0;
+}
+
+
+// NOTE: Compares glyph_sdf with stbtt_GetGlyphSDF for the ASCII glyphs at a few sizes, with the parameters of load_glyph.
+//       The box has to be the same. The values differ slightly where the sampled outline loses thin tips,
+//       so the mean differences are checked, and most pixels have to be close. The DejaVu fonts stay
+//       below 5 per glyph and 2.3 overall, half a sample off is already above 3 overall.
+INTERNAL b32 check_glyph_sdfs(Font *font) {
+    r32 const Heights[] = {12, 16, 32, 64};
+
+    BenchCheck state = {};
+    s64 pixels = 0;
+    s64 total_difference = 0;
+
+    for (r32 height : Heights) {
+        r32 scale = stbtt_ScaleForPixelHeight(&font->info, height);
+
+        for (u32 cp = 33; cp < 127; cp += 1) {
+            s32 glyph = stbtt_FindGlyphIndex(&font->info, cp);
+
+            s32 w, h, x, y;
+            u8 *ours = glyph_sdf(&font->info, scale, glyph, 4, 180, 36, &w, &h, &x, &y);
+
+            s32 stb_w = 0, stb_h = 0, stb_x = 0, stb_y = 0;
+            u8 *theirs = stbtt_GetGlyphSDF(&font->info, scale, glyph, 4, 180, 36, &stb_w, &stb_h, &stb_x, &stb_y);
+
+            b32 same_box = (ours != 0) == (theirs != 0);
+            if (ours && theirs) same_box = w == stb_w && h == stb_h && x == stb_x && y == stb_y;
+            check(&state, same_box, "glyph_sdf box", cp);
+
+            if (ours && theirs && same_box) {
+                s64 difference = 0;
+                s64 far = 0;
+                for (s64 i = 0; i < (s64)w * h; i += 1) {
+                    s32 d = ours[i] > theirs[i] ? ours[i] - theirs[i] : theirs[i] - ours[i];
+                    difference += d;
+                    if (d > 18) far += 1; // NOTE: Half a pixel with a pixel_dist_scale of 36.
+                }
+
+                pixels           += (s64)w * h;
+                total_difference += difference;
+
+                check(&state, difference <= (s64)w * h * 6, "glyph_sdf mean difference", cp);
+                check(&state, far * 50 <= (s64)w * h,       "glyph_sdf far pixels",      cp);
+            }
+
+            if (ours) DEALLOC(DefaultAllocator, ours, (s64)w * h);
+            if (theirs) stbtt_FreeSDF(theirs, 0);
+        }
+    }
+
+    r64 mean = pixels ? (r64)total_difference / pixels : 0;
+    check(&state, mean <= 3, "glyph_sdf overall mean difference", 0);
+
+    print("Glyph SDFs: %D checks, %D failures, mean difference to stbtt %f.\n", state.checks, state.failures, mean);
+
+    return state.failures == 0;
+}
+
+
+//===============================================
+// Config and fonts
+//===============================================
+INTERNAL void bench_config_parse(void *data, s64 iterations) {
+    BenchData *bench = (BenchData*)data;
+
+    for (s64 i = 0; i < iterations; i += 1) {
+        Configuration config = {};
+        if (!init(&config, bench->config_file)) return;
+
+        bench_keep(entry_s64(&config, "section7", "key42"));
+        destroy(&config);
+    }
+}
+
+INTERNAL void bench_config_lookup(void *data, s64 iterations) {
+    BenchData *bench = (BenchData*)data;
+
+    Configuration config = {};
+    if (!init(&config, bench->config_file)) return;
+    DEFER(destroy(&config));
+
+    for (s64 i = 0; i < iterations; i += 1) {
+        bench_keep(entry_s64(&config, "section7", "key42"));
+    }
+}
+
+// NOTE: Every glyph is a miss, this measures the distance field generation of the 95 ASCII glyphs.
+INTERNAL void bench_glyph_load(void *data, s64 iterations) {
+    BenchData *bench = (BenchData*)data;
+
+    for (s64 i = 0; i < iterations; i += 1) {
+        Font font = {};
+        if (!init(&font, bench->font_file, 32, 1024)) return;
+
+        bench_keep((u64)font.cache_used);
+        destroy(&font);
+    }
+}
+
+INTERNAL void bench_glyph_lookup(void *data, s64 iterations) {
+    BenchData *bench = (BenchData*)data;
+
+    for (s64 i = 0; i < iterations; i += 1) {
+        r32 sum = 0;
+        for (u32 cp = 32; cp < 127; cp += 1) {
+            sum += get_glyph(&bench->font, cp, 16).advance;
+        }
+
+        bench_keep((u64)sum);
+    }
+}
+
+
+INTERNAL String make_text(u64 *random, b32 mixed) {
+    // NOTE: ä, €, 😀 are 2, 3 and 4 bytes.
+    String const sequences[] = {"\xC3\xA4", "\xE2\x82\xAC", "\xF0\x9F\x98\x80"};
+
+    String text = allocate_string(BenchTextSize);
+    s64 size = 0;
+
+    while (size < text.size) {
+        u64 r = next_random(random);
+
+        String add = {};
+        u8 c;
+        if (mixed && r % 3 == 0) {
+            add = sequences[(r >> 8) % C_ARRAY_SIZE(sequences)];
+        } else {
+            c = (r >> 8) % 64 == 0 ? '\n' : (u8)(' ' + (r >> 16) % 94); // NOTE: Never '~', the byte search has to go to the end.
+            add = {&c, 1};
+        }
+
+        if (size + add.size > text.size) break;
+        copy_memory(text.data + size, add.data, add.size);
+        size += add.size;
+    }
+
+    text.size = size;
+
+    return text;
+}
+
+INTERNAL b32 write_config_file(String file_name) {
+    StringBuilder builder;
+    init(&builder);
+    DEFER(destroy(&builder));
+
+    for (s32 section = 0; section < 20; section += 1) {
+        format(&builder, "[section%d]\n", section);
+
+        for (s32 key = 0; key < 50; key += 1) {
+            format(&builder, "key%d = %d ; comment\n", key, key * section);
+        }
+    }
+
+    PlatformFile file = platform_file_open(file_name, PlatformFileOverride);
+    if (!file.open) return false;
+
+    b32 written = write_builder_to_file(&builder, &file);
+    platform_file_close(&file);
+
+    return written;
+}
+
+s32 application_main(Array<String> args) {
+    BenchSuite suite;
+    init(&suite);
+    DEFER(destroy(&suite));
+
+    String csv_file  = {};
+    String json_file = {};
+    String font_file = {};
+
+    for (s64 i = 1; i < args.size; i += 1) {
+        String arg = args[i];
+        b32 has_value = i + 1 < args.size;
+
+        if      (arg == "--filter"      && has_value) suite.filter      = args[++i];
+        else if (arg == "--repetitions" && has_value) suite.repetitions = (s32)to_s64(args[++i]);
+        else if (arg == "--warmup"      && has_value) suite.warmup      = (s32)to_s64(args[++i]);
+        else if (arg == "--min-time"    && has_value) suite.min_time_ms = to_r32(args[++i]);
+        else if (arg == "--csv"         && has_value) csv_file  = args[++i];
+        else if (arg == "--json"        && has_value) json_file = args[++i];
+        else if (arg == "--font"        && has_value) font_file = args[++i];
+        else {
+            print("Unknown argument %S.\n", arg);
+            return 1;
+        }
+    }
+
+    BenchData *data = ALLOC(DefaultAllocator, BenchData, 1);
+    INIT_STRUCT(data);
+    DEFER(DEALLOC(DefaultAllocator, data, 1));
+
+    u64 random = 0x9E3779B97F4A7C15;
+    if (!check_string_primitives(&random))  return 1;
+    if (!check_schema_round_trips(&random)) return 1;
+    if (!check_text_buffer_edits(&random))  return 1;
+
+    init(&data->table, 4);
+    for (s64 k = 0; k < BenchItems; k += 1) {
+        // NOTE: Even keys only, key + 1 is a guaranteed miss.
+        data->keys[k] = next_random(&random) & ~(u64)1;
+        insert(&data->table, data->keys[k], (u64)k);
+    }
+
+    data->ascii_text = make_text(&random, false);
+    data->mixed_text = make_text(&random, true);
+
+    data->mixed_text16 = to_utf16(DefaultAllocator, data->mixed_text);
+    data->conversion_buffer16 = {ALLOC(DefaultAllocator, u16, data->mixed_text16.size), data->mixed_text16.size};
+    data->conversion_buffer8  = allocate_string(data->mixed_text.size);
+
+    if (font_file.size) {
+        data->font_file = font_file;
+        data->has_font = init(&data->font, font_file, 16, 1024);
+        if (!data->has_font) print("Could not load the font %S.\n", font_file);
+    }
+
+    if (data->has_font && !check_glyph_sdfs(&data->font)) {
+        destroy(&data->font);
+        return 1;
+    }
+
+    data->config_file = "bench_config.ini";
+    if (!write_config_file(data->config_file)) print("Could not write %S, the config benchmarks will do nothing.\n", data->config_file);
+
+    run_benchmark(&suite, "hash_table/insert_4096",           bench_hash_table_insert,     data);
+    run_benchmark(&suite, "hash_table/find_4096",             bench_hash_table_find,       data);
+    run_benchmark(&suite, "hash_table/miss_4096",             bench_hash_table_miss,       data);
+    run_benchmark(&suite, "list/append_4096",                 bench_list_append,           data);
+    run_benchmark(&suite, "string_builder/append_4096",       bench_string_builder_append, data);
+
+    run_benchmark(&suite, "format/builder_256",               bench_format,                data);
+    run_benchmark(&suite, "format/file_256",                  bench_print,                 data);
+
+    run_benchmark(&suite, "utf/utf8_to_utf16_64k",            bench_utf8_to_utf16,         data);
+    run_benchmark(&suite, "utf/utf16_to_utf8_64k",            bench_utf16_to_utf8,         data);
+    run_benchmark(&suite, "utf/decode_block_64k",             bench_utf8_decode,           data);
+    run_benchmark(&suite, "utf/length_64k",                   bench_utf8_length,           data);
+
+    run_benchmark(&suite, "string/find_byte_64k",             bench_find_byte,             data);
+    run_benchmark(&suite, "string/find_byte_64k_scalar",      bench_find_byte_scalar,      data);
+    run_benchmark(&suite, "string/find_last_64k",             bench_find_last,             data);
+    run_benchmark(&suite, "string/find_last_64k_scalar",      bench_find_last_scalar,      data);
+    run_benchmark(&suite, "string/find_string_64k",           bench_find_string,           data);
+    run_benchmark(&suite, "string/find_string_64k_scalar",    bench_find_string_scalar,    data);
+    run_benchmark(&suite, "string/next_line_64k",             bench_next_line,             data);
+    run_benchmark(&suite, "string/equal_64k",                 bench_equal,                 data);
+    run_benchmark(&suite, "string/equal_64k_scalar",          bench_equal_scalar,          data);
+    run_benchmark(&suite, "string/caseless_equal_64k",        bench_caseless_equal,        data);
+    run_benchmark(&suite, "string/caseless_equal_64k_scalar", bench_caseless_equal_scalar, data);
+
+    run_benchmark(&suite, "config/parse_1000_lines",          bench_config_parse,          data);
+    run_benchmark(&suite, "config/lookup",                    bench_config_lookup,         data);
+
+    if (data->has_font) run_benchmark(&suite, "font/glyph_load_95",   bench_glyph_load,   data);
+    if (data->has_font) run_benchmark(&suite, "font/glyph_lookup_95", bench_glyph_lookup, data);
+
+    print_results(&suite);
+
+    b32 ok = true;
+    if (csv_file.size  && !write_csv (&suite, csv_file))  { print("Could not write %S.\n", csv_file);  ok = false; }
+    if (json_file.size && !write_json(&suite, json_file)) { print("Could not write %S.\n", json_file); ok = false; }
+
+    platform_delete_file(data->config_file);
+    if (data->has_font) destroy(&data->font);
+    destroy(&data->table);
+    destroy(&data->ascii_text);
+    destroy(&data->mixed_text);
+    destroy(&data->conversion_buffer8);
+    DEALLOC(DefaultAllocator, data->conversion_buffer16.data, data->conversion_buffer16.size);
+    DEALLOC(DefaultAllocator, data->mixed_text16.data, data->mixed_text16.size);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,86 @@
+#include "atom.h"
+
+
+void init(AtomTable *table, Allocator alloc) {
+    s32 const initial_exponent = 6;
+
+    destroy(table);
+
+    table->allocator = alloc;
+    table->blocks.allocator  = alloc;
+    table->strings.allocator = alloc;
+    init(&table->lookup, initial_exponent, alloc);
+}
+
+void destroy(AtomTable *table) {
+    if (table->allocator.allocate) {
+        FOR (table->blocks, block) {
+            destroy(block);
+        }
+
+        destroy(&table->blocks);
+        destroy(&table->strings);
+        destroy(&table->lookup);
+    }
+
+    INIT_STRUCT(table);
+}
+
+INTERNAL String copy_to_block(AtomTable *table, String str) {
+    // NOTE: Arena allocations are pointer aligned so some padding has to fit, too.
+    s64 needed = str.size + (s64)alignof(void*);
+
+    MemoryArena *arena = 0;
+    if (table->blocks.size) {
+        arena = &table->blocks[-1];
+        if (arena->alloc - arena->used < needed) arena = 0;
+    }
+
+    if (arena == 0) {
+        s64 size = ATOM_TABLE_BLOCK_SIZE;
+        if (size < needed) size = needed;
+
+        arena = append(&table->blocks);
+        INIT_STRUCT(arena);
+        init(arena, size, table->allocator);
+    }
+
+    String result = {};
+    if (str.size) {
+        result.data = (u8*)allocate_from_arena(arena, str.size, 0, 0);
+        result.size = str.size;
+        copy_memory(result.data, str.data, str.size);
+    } else {
+        result.data = arena->memory + arena->used;
+    }
+
+    return result;
+}
+
+Atom intern(AtomTable *table, String str) {
+    if (table->allocator.allocate == 0) init(table);
+
+    Atom *existing = find(&table->lookup, str);
+    if (existing) return *existing;
+
+    String stored = copy_to_block(table, str);
+    append(&table->strings, stored);
+
+    Atom atom = (Atom)table->strings.size;
+    insert(&table->lookup, stored, atom);
+
+    return atom;
+}
+
+Atom find_atom(AtomTable *table, String str) {
+    Atom *atom = find(&table->lookup, str);
+    if (atom) return *atom;
+
+    return NoAtom;
+}
+
+String atom_string(AtomTable *table, Atom atom) {
+    if (atom == NoAtom) return {};
+
+    return table->strings[atom - 1];
+}
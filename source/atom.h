@@ -0,0 +1,49 @@
+//================================================
+// An AtomTable interns strings and hands out a
+// stable 32 bit id (Atom) for each distinct string.
+// Comparing and hashing atoms is a single integer
+// operation, so repeated lookups of the same keys
+// (config sections and keys, identifiers, ...)
+// don't have to compare the bytes every time.
+//
+// The interned strings live in arena blocks owned
+// by the table and stay valid until it is destroyed.
+// find_atom and atom_string never modify the table
+// and can be called from multiple threads as long
+// as nobody interns at the same time.
+//================================================
+#pragma once
+
+#include "list.h"
+#include "arena.h"
+#include "string2.h"
+#include "hash_table.h"
+
+
+typedef u32 Atom;
+Atom const NoAtom = 0;
+
+#ifndef ATOM_TABLE_BLOCK_SIZE
+#define ATOM_TABLE_BLOCK_SIZE KILOBYTES(4)
+#endif
+
+struct AtomTable {
+    Allocator allocator;
+
+    List<MemoryArena> blocks;
+    List<String> strings; // NOTE: Indexed by atom - 1.
+
+    HashTable<String, Atom> lookup;
+};
+
+
+void init(AtomTable *table, Allocator alloc = DefaultAllocator);
+void destroy(AtomTable *table);
+
+Atom   intern(AtomTable *table, String str);
+Atom   find_atom(AtomTable *table, String str);
+String atom_string(AtomTable *table, Atom atom);
+
+inline s64 atom_count(AtomTable *table) {
+    return table->strings.size;
+}
@@ -0,0 +1,75 @@
+//================================================
+// Minimal atomics for the few places that share
+// data between threads. Loads acquire, stores
+// release and the read-modify-write operations
+// are sequentially consistent.
+//================================================
+#pragma once
+
+#include "definitions.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+
+template<class Type>
+Type *atomic_load(Type *volatile *ptr) {
+#ifdef _MSC_VER
+    // NOTE: Aligned loads on x86/x64 already have acquire semantics.
+    Type *result = *ptr;
+    _ReadWriteBarrier();
+
+    return result;
+#else
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+#endif
+}
+
+template<class Type>
+void atomic_store(Type *volatile *ptr, Type *value) {
+#ifdef _MSC_VER
+    _ReadWriteBarrier();
+    *ptr = value;
+#else
+    __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+#endif
+}
+
+template<class Type>
+Type *atomic_exchange(Type *volatile *ptr, Type *value) {
+#ifdef _MSC_VER
+    return (Type*)_InterlockedExchangePointer((void *volatile*)ptr, value);
+#else
+    return __atomic_exchange_n(ptr, value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// NOTE: Returns the value before the addition.
+inline s64 atomic_add(s64 volatile *value, s64 addend) {
+#ifdef _MSC_VER
+    return _InterlockedExchangeAdd64((long long volatile*)value, addend);
+#else
+    return __atomic_fetch_add(value, addend, __ATOMIC_SEQ_CST);
+#endif
+}
+
+inline s64 atomic_load(s64 volatile *value) {
+#ifdef _MSC_VER
+    s64 result = *value;
+    _ReadWriteBarrier();
+
+    return result;
+#else
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+#endif
+}
+
+inline void atomic_store(s64 volatile *value, s64 new_value) {
+#ifdef _MSC_VER
+    _ReadWriteBarrier();
+    *value = new_value;
+#else
+    __atomic_store_n(value, new_value, __ATOMIC_RELEASE);
+#endif
+}
@@ -4,12 +4,56 @@
 #include "string_builder.h"
 
 
+// NOTE: On little endian hosts the loads below are plain copies
+//       and bulk reads compile down to a single memcpy.
+#if (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) || \
+    defined(_M_X64) || defined(_M_IX86) || defined(_M_ARM64)
+#define BINARY_LITTLE_ENDIAN
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define BINARY_COPY(dest, src, size) __builtin_memcpy(dest, src, size)
+#else
+#include <string.h>
+#define BINARY_COPY(dest, src, size) memcpy(dest, src, size)
+#endif
+
+
+template<class Type>
+inline Type load_le(u8 const *data) {
+    Type result;
+
+#ifdef BINARY_LITTLE_ENDIAN
+    BINARY_COPY(&result, data, sizeof(Type));
+#else
+    u8 swapped[sizeof(Type)];
+    for (s64 i = 0; i < (s64)sizeof(Type); i += 1) {
+        swapped[i] = data[sizeof(Type) - 1 - i];
+    }
+    BINARY_COPY(&result, swapped, sizeof(Type));
+#endif
+
+    return result;
+}
+
+template<class Type>
+inline void load_le_array(Type *out, u8 const *data, s64 count) {
+#ifdef BINARY_LITTLE_ENDIAN
+    BINARY_COPY(out, data, count * sizeof(Type));
+#else
+    for (s64 i = 0; i < count; i += 1) {
+        out[i] = load_le<Type>(data + i * sizeof(Type));
+    }
+#endif
+}
+
+
 inline u8 read_byte(String buffer, s64 offset) {
 #ifdef BOUNDS_CHECKING
-    if (buffer.size < offset) die("String read out of bounds.");
+    if (buffer.size < offset + 1) die("String read out of bounds.");
 #endif
 
-    return buffer[offset];
+    return buffer.data[offset];
 }
 inline u8 read_byte(String buffer, s64 *offset) {
     u8 result = read_byte(buffer, *offset);
@@ -22,9 +66,8 @@ inline u16 read_le_u16(String buffer, s64 offset) {
 #ifdef BOUNDS_CHECKING
     if (buffer.size < offset + (s64)sizeof(u16)) die("String read out of bounds.");
 #endif
-    u8 *data = buffer.data + offset;
 
-    return data[0] | (data[1] << 8);
+    return load_le<u16>(buffer.data + offset);
 }
 inline u16 read_le_u16(String buffer, s64 *offset) {
     u16 result = read_le_u16(buffer, *offset);
@@ -37,9 +80,8 @@ inline u32 read_le_u32(String buffer, s64 offset) {
 #ifdef BOUNDS_CHECKING
     if (buffer.size < offset + (s64)sizeof(u32)) die("String read out of bounds.");
 #endif
-    u8 *data = buffer.data + offset;
 
-    return data[0] | (data[1] << 8) | (data[2] << 16) | (data[3] << 24);
+    return load_le<u32>(buffer.data + offset);
 }
 inline u32 read_le_u32(String buffer, s64 *offset) {
     u32 result = read_le_u32(buffer, *offset);
@@ -52,12 +94,8 @@ inline u64 read_le_u64(String buffer, s64 offset) {
 #ifdef BOUNDS_CHECKING
     if (buffer.size < offset + (s64)sizeof(u64)) die("String read out of bounds.");
 #endif
-    u8 *data = buffer.data + offset;
 
-    u64 result = (data[0])            | (data[1] << 8)       | (data[2] << 16)      | (data[3] << 24) |
-                 ((u64)data[4] << 32) | ((u64)data[5] << 40) | ((u64)data[6] << 48) | ((u64)data[7] << 56);
-
-    return result;
+    return load_le<u64>(buffer.data + offset);
 }
 inline u64 read_le_u64(String buffer, s64 *offset) {
     u64 result = read_le_u64(buffer, *offset);
@@ -70,10 +108,12 @@ inline s64 read_le_s64(String buffer, s64 offset) {
 #ifdef BOUNDS_CHECKING
     if (buffer.size < offset + (s64)sizeof(s64)) die("String read out of bounds.");
 #endif
-    u8 *data = buffer.data + offset;
 
-    s64 result = (data[0])            | (data[1] << 8)       | (data[2] << 16)      | (data[3] << 24) |
-                 ((s64)data[4] << 32) | ((s64)data[5] << 40) | ((s64)data[6] << 48) | ((s64)data[7] << 56);
+    return load_le<s64>(buffer.data + offset);
+}
+inline s64 read_le_s64(String buffer, s64 *offset) {
+    s64 result = read_le_s64(buffer, *offset);
+    *offset += sizeof(s64);
 
     return result;
 }
@@ -82,9 +122,8 @@ inline r32 read_le_r32(String buffer, s64 offset) {
 #ifdef BOUNDS_CHECKING
     if (buffer.size < offset + (s64)sizeof(r32)) die("String read out of bounds.");
 #endif
-    u32 tmp = read_le_u32(buffer, offset);
 
-    return *(r32*)&tmp;
+    return load_le<r32>(buffer.data + offset);
 }
 inline r32 read_le_r32(String buffer, s64 *offset) {
     r32 result = read_le_r32(buffer, *offset);
@@ -93,38 +132,282 @@ inline r32 read_le_r32(String buffer, s64 *offset) {
     return result;
 }
 
-// TODO: Change to varints?
-inline String read_binary_string(String buffer, s64 offset) {
-    u32 length = read_le_u32(buffer, &offset);
+
+//===============================================
+// Bulk reads, the bounds are checked once for
+// the whole array.
+//===============================================
+template<class Type>
+inline void read_le_array(String buffer, s64 *offset, Type *out, s64 count) {
+#ifdef BOUNDS_CHECKING
+    if (count < 0 || buffer.size < *offset + count * (s64)sizeof(Type)) die("String read out of bounds.");
+#endif
+
+    load_le_array(out, buffer.data + *offset, count);
+    *offset += count * sizeof(Type);
+}
+
+inline void read_le_u16_array(String buffer, s64 *offset, u16 *out, s64 count) { read_le_array(buffer, offset, out, count); }
+inline void read_le_u32_array(String buffer, s64 *offset, u32 *out, s64 count) { read_le_array(buffer, offset, out, count); }
+inline void read_le_u64_array(String buffer, s64 *offset, u64 *out, s64 count) { read_le_array(buffer, offset, out, count); }
+inline void read_le_r32_array(String buffer, s64 *offset, r32 *out, s64 count) { read_le_array(buffer, offset, out, count); }
+
+
+//===============================================
+// LEB128 varints, 7 bits per byte with the high
+// bit set on every byte but the last. Signed
+// values are zigzag encoded first so small
+// negative numbers stay small.
+//===============================================
+s32 const MaxVarintBytes = 10;
+
+inline u64 zigzag_encode(s64 value) {
+    return ((u64)value << 1) ^ (u64)(value >> 63);
+}
+
+inline s64 zigzag_decode(u64 value) {
+    return (s64)(value >> 1) ^ -(s64)(value & 1);
+}
+
+// NOTE: Returns the bytes written, out needs room for MaxVarintBytes.
+inline s32 encode_varint(u8 *out, u64 value) {
+    s32 bytes = 0;
+
+    while (value >= 0x80) {
+        out[bytes] = (u8)(value | 0x80);
+        value >>= 7;
+        bytes += 1;
+    }
+    out[bytes] = (u8)value;
+
+    return bytes + 1;
+}
+
+// NOTE: Returns the bytes consumed, 0 if the varint is cut off or longer than MaxVarintBytes.
+inline s32 decode_varint(u8 const *at, u8 const *end, u64 *value) {
+    if (at < end && at[0] < 0x80) {
+        *value = at[0];
+
+        return 1;
+    }
+
+    u64 result = 0;
+    s64 available = end - at;
+    if (available > MaxVarintBytes) available = MaxVarintBytes;
+
+    for (s32 i = 0; i < available; i += 1) {
+        result |= (u64)(at[i] & 0x7F) << (7 * i);
+
+        if (at[i] < 0x80) {
+            *value = result;
+
+            return i + 1;
+        }
+    }
+
+    *value = 0;
+
+    return 0;
+}
+
+inline u64 read_varint(String buffer, s64 *offset) {
+    u64 value;
+    s32 bytes = decode_varint(buffer.data + *offset, buffer.data + buffer.size, &value);
 
 #ifdef BOUNDS_CHECKING
-    if (buffer.size < offset + length) die("String read out of bounds.");
+    if (bytes == 0) die("Invalid varint.");
 #endif
-    return {buffer.data + offset, length};
+    *offset += bytes;
+
+    return value;
 }
+
+inline s64 read_varint_signed(String buffer, s64 *offset) {
+    return zigzag_decode(read_varint(buffer, offset));
+}
+
+
 inline String read_binary_string(String buffer, s64 *offset) {
-    u32 length = read_le_u32(buffer, offset);
+    u64 length = read_varint(buffer, offset);
 
 #ifdef BOUNDS_CHECKING
-    if (buffer.size < *offset + length) die("String read out of bounds.");
+    if (buffer.size - *offset < (s64)length) die("String read out of bounds.");
 #endif
-    String result = {buffer.data + *offset, length};
+    String result = {buffer.data + *offset, (s64)length};
     *offset += length;
 
     return result;
 }
+inline String read_binary_string(String buffer, s64 offset) {
+    return read_binary_string(buffer, &offset);
+}
+
+
+//===============================================
+// A cursor for reading files that might be broken.
+// Instead of dying it sets error on the first read
+// past the end and returns zeros from then on.
+// For hot loops reserve the bytes of a whole block
+// once and use the unchecked reads inside of it.
+//===============================================
+struct BinaryReader {
+    String buffer;
+    s64 offset;
 
+    b32 error;
+};
+
+inline BinaryReader make_binary_reader(String buffer, s64 offset = 0) {
+    BinaryReader reader = {};
+    reader.buffer = buffer;
+    reader.offset = offset;
+    reader.error  = offset < 0 || offset > buffer.size;
+
+    return reader;
+}
+
+inline s64 remaining(BinaryReader *reader) {
+    return reader->error ? 0 : reader->buffer.size - reader->offset;
+}
+
+inline b32 reserve(BinaryReader *reader, s64 bytes) {
+    if (bytes < 0 || remaining(reader) < bytes) reader->error = true;
+
+    return !reader->error;
+}
+
+inline void skip(BinaryReader *reader, s64 bytes) {
+    if (reserve(reader, bytes)) reader->offset += bytes;
+}
+
+template<class Type>
+inline Type read_unchecked(BinaryReader *reader) {
+    assert(reader->offset + (s64)sizeof(Type) <= reader->buffer.size);
+
+    Type result = load_le<Type>(reader->buffer.data + reader->offset);
+    reader->offset += sizeof(Type);
+
+    return result;
+}
+
+template<class Type>
+inline Type read(BinaryReader *reader) {
+    if (!reserve(reader, sizeof(Type))) return {};
+
+    return read_unchecked<Type>(reader);
+}
+
+inline u8  read_u8 (BinaryReader *reader) { return read<u8>(reader);  }
+inline u16 read_u16(BinaryReader *reader) { return read<u16>(reader); }
+inline u32 read_u32(BinaryReader *reader) { return read<u32>(reader); }
+inline u64 read_u64(BinaryReader *reader) { return read<u64>(reader); }
+inline s64 read_s64(BinaryReader *reader) { return read<s64>(reader); }
+inline r32 read_r32(BinaryReader *reader) { return read<r32>(reader); }
 
+template<class Type>
+inline b32 read_array(BinaryReader *reader, Type *out, s64 count) {
+    if (count < 0 || remaining(reader) / (s64)sizeof(Type) < count) {
+        reader->error = true;
+
+        return false;
+    }
+
+    load_le_array(out, reader->buffer.data + reader->offset, count);
+    reader->offset += count * sizeof(Type);
+
+    return true;
+}
+
+inline u64 read_varint(BinaryReader *reader) {
+    if (reader->error) return 0;
+
+    u64 value;
+    s32 bytes = decode_varint(reader->buffer.data + reader->offset, reader->buffer.data + reader->buffer.size, &value);
+
+    if (bytes == 0) reader->error = true;
+    reader->offset += bytes;
+
+    return value;
+}
+
+inline s64 read_varint_signed(BinaryReader *reader) {
+    return zigzag_decode(read_varint(reader));
+}
+
+// NOTE: Points into the buffer, nothing is copied.
+inline String read_string(BinaryReader *reader) {
+    u64 length = read_varint(reader);
+    if (reader->error || (u64)remaining(reader) < length) {
+        reader->error = true;
+
+        return {};
+    }
+
+    String result = {reader->buffer.data + reader->offset, (s64)length};
+    reader->offset += length;
+
+    return result;
+}
+
+
+// NOTE: Values are written in host order, every platform we support is little endian.
 template<class Type>
 inline void write_binary(StringBuilder *builder, Type value) {
     append_raw(builder, &value, sizeof(value));
 }
 
-// TODO: Write varints?
-inline void write_binary_string(StringBuilder *builder, String string) {
-    u32 length = (u32)string.size;
+template<class Type>
+inline void write_binary_array(StringBuilder *builder, Type const *values, s64 count) {
+    append_raw(builder, (void*)values, count * sizeof(Type));
+}
 
-    write_binary(builder, length);
-    append(builder, string);
+// NOTE: Overwrites already written bytes, used to fill in offsets that are only known later.
+inline void patch_binary(StringBuilder *builder, s64 offset, void const *data, s64 size) {
+    assert(offset >= 0 && offset + size <= builder->total_size);
+
+    u8 const *src = (u8 const*)data;
+    for (auto *block = &builder->first; block && size; block = block->next) {
+        if (offset >= block->used) {
+            offset -= block->used;
+            continue;
+        }
+
+        s64 bytes = block->used - offset;
+        if (bytes > size) bytes = size;
+
+        BINARY_COPY(block->buffer + offset, src, bytes);
+        src    += bytes;
+        size   -= bytes;
+        offset  = 0;
+    }
 }
 
+template<class Type>
+inline void patch_binary(StringBuilder *builder, s64 offset, Type value) {
+    patch_binary(builder, offset, &value, sizeof(value));
+}
+
+// NOTE: Pads with zeros until the total size is a multiple of alignment.
+inline void align_binary(StringBuilder *builder, s64 alignment) {
+    u8 const zeros[16] = {};
+    assert(alignment <= 16);
+
+    s64 padding = (alignment - builder->total_size % alignment) % alignment;
+    if (padding) append_raw(builder, (void*)zeros, padding);
+}
+
+inline void write_varint(StringBuilder *builder, u64 value) {
+    u8 buffer[MaxVarintBytes];
+    s32 bytes = encode_varint(buffer, value);
+
+    append_raw(builder, buffer, bytes);
+}
+
+inline void write_varint_signed(StringBuilder *builder, s64 value) {
+    write_varint(builder, zigzag_encode(value));
+}
+
+inline void write_binary_string(StringBuilder *builder, String string) {
+    write_varint(builder, (u64)string.size);
+    append(builder, string);
+}
@@ -2,6 +2,8 @@
 
 #include "platform.h"
 #include "string2.h"
+#include "atomic.h"
+#include "binary.h"
 
 
 enum TokenKind {
@@ -32,178 +34,185 @@ struct Parser {
     ParseStatus status;
     String source;
 
-    s64 current_pos;
+    // NOTE: The tokenizer works directly on the pointers, the bounds are
+    //       only checked against input_end.
+    u8 *at;
+    u8 *input_end;
     s32 current_line;
 
     Token current_token;
     Token previous_token;
 
+    s32    error_line;
+    String error_message;
+
     ConfigurationSection *current_section;
 };
 
 
-INTERNAL b32 peek_char(Parser *parser, u8 *c) {
-    if (parser->current_pos < parser->source.size) {
-        *c = parser->source[parser->current_pos];
-
-        return true;
-    }
+//===============================================
+// Every byte maps to a class so the tokenizer only
+// needs a single lookup to decide what to do.
+// CHAR_STRING and CHAR_WHITESPACE have to stay the
+// first two as unquoted strings can contain both.
+//===============================================
+enum CharClass {
+    CHAR_STRING,
+    CHAR_WHITESPACE,
+    CHAR_NEW_LINE,
+    CHAR_EQUAL,
+    CHAR_LEFT_BRACKET,
+    CHAR_RIGHT_BRACKET,
+    CHAR_COMMENT,
+    CHAR_QUOTE,
+};
 
-    return false;
-}
+struct CharClassTable {
+    u8 classes[256];
+};
 
-INTERNAL b32 get_char(Parser *parser, u8 *c) {
-    if (peek_char(parser, c)) {
-        parser->current_pos += 1;
+INTERNAL constexpr CharClassTable make_char_class_table() {
+    CharClassTable table = {};
 
-        return true;
-    }
+    table.classes[' ']  = CHAR_WHITESPACE;
+    table.classes['\t'] = CHAR_WHITESPACE;
+    table.classes['\n'] = CHAR_NEW_LINE;
+    table.classes['\r'] = CHAR_NEW_LINE;
+    table.classes['=']  = CHAR_EQUAL;
+    table.classes['[']  = CHAR_LEFT_BRACKET;
+    table.classes[']']  = CHAR_RIGHT_BRACKET;
+    table.classes[';']  = CHAR_COMMENT;
+    table.classes['"']  = CHAR_QUOTE;
 
-    return false;
+    return table;
 }
 
-INTERNAL void skip_whitespaces(Parser *parser) {
-    u8 c;
-    while (peek_char(parser, &c) && is_any(c, " \t")) {
-        parser->current_pos += 1;
-    }
-}
+INTERNAL CharClassTable const CharClasses = make_char_class_table();
 
-INTERNAL String make_token_content(Parser *parser, s64 size) {
-    String result = {};
-    result.data = &parser->source[parser->current_pos];
-    result.size = size;
 
-    return result;
+INTERNAL String rest_of_input(Parser *parser, u8 *at) {
+    return {at, parser->input_end - at};
 }
 
-INTERNAL Token parse_comment(Parser *parser) {
-    Token token = {};
-    token.kind  = TOKEN_COMMENT;
-    token.line  = parser->current_line;
-
-    parser->current_pos += 1;
-    token.content.data = &parser->source[parser->current_pos];
+INTERNAL Token next_token(Parser *parser) {
+    u8 *at = parser->at;
 
-    u8 c;
-    while (peek_char(parser, &c) && (c != '\n' && c != '\r')) {
-        token.content.size += 1;
-        parser->current_pos += 1;
+    while (at < parser->input_end && CharClasses.classes[*at] == CHAR_WHITESPACE) {
+        at += 1;
     }
 
-    return token;
-}
-
-INTERNAL Token parse_quoted_string(Parser *parser) {
     Token token = {};
-    token.kind  = TOKEN_STRING;
-    token.line  = parser->current_line;
-
-    u8 c;
-    if (!get_char(parser, &c) || c != '"') {
-        token.kind = TOKEN_ERROR;
-        token.content = "Expected \" to start string.";
+    token.line = parser->current_line;
 
-        parser->status = PARSE_ERROR;
+    if (at == parser->input_end) {
+        token.kind = TOKEN_END_OF_INPUT;
+        parser->status = PARSE_END;
+        parser->at = at;
 
         return token;
     }
 
-    token.content.data = &parser->source[parser->current_pos];
-
-    while (get_char(parser, &c)) {
-        if (c == '"') break;
-
-        token.content.size += 1;
-    }
-
-    if (c != '"') {
-        token.kind = TOKEN_ERROR;
-        token.content = "Unterminated string.";
-
-        parser->status = PARSE_ERROR;
-    }
-
-    return token;
-}
-
-INTERNAL Token parse_string(Parser *parser) {
-    Token token = {};
-    token.kind  = TOKEN_STRING;
-    token.line  = parser->current_line;
-    token.content.data = &parser->source[parser->current_pos];
-
-    u8 c;
-    while (peek_char(parser, &c)) {
-        if (is_any(c, "=[];\n\r\"")) break;
+    switch (CharClasses.classes[*at]) {
+    case CHAR_EQUAL: {
+        token.kind    = TOKEN_EQUAL;
+        token.content = {at, 1};
+        at += 1;
+    } break;
+
+    case CHAR_LEFT_BRACKET: {
+        token.kind    = TOKEN_LEFT_BRACKET;
+        token.content = {at, 1};
+        at += 1;
+    } break;
+
+    case CHAR_RIGHT_BRACKET: {
+        token.kind    = TOKEN_RIGHT_BRACKET;
+        token.content = {at, 1};
+        at += 1;
+    } break;
+
+    case CHAR_NEW_LINE: {
+        // NOTE: \r\n and \n\r are a single line break.
+        u8 c = *at;
+        at += 1;
+
+        if (at < parser->input_end && CharClasses.classes[*at] == CHAR_NEW_LINE && *at != c) {
+            at += 1;
+        }
+        parser->current_line += 1;
+        token.kind = TOKEN_NEW_LINE;
+    } break;
 
-        token.content.size  += 1;
-        parser->current_pos += 1;
-    };
+    case CHAR_COMMENT: {
+        at += 1;
 
-    token.content = trim(token.content);
+        s64 length = find_first_of(rest_of_input(parser, at), '\n', '\r');
+        if (length == -1) length = parser->input_end - at;
 
-    return token;
-}
+        token.kind    = TOKEN_COMMENT;
+        token.content = {at, length};
+        at += length;
+    } break;
 
-INTERNAL Token next_token(Parser *parser) {
-    skip_whitespaces(parser);
+    case CHAR_QUOTE: {
+        at += 1;
 
-    Token token = {};
-    token.line = parser->current_line;
+        s64 length = find_first(rest_of_input(parser, at), '"');
+        if (length == -1) {
+            token.kind    = TOKEN_ERROR;
+            token.content = "Unterminated string.";
 
-    u8 c;
-    if (peek_char(parser, &c)) {
-        if (c == '[') {
-            token.kind    = TOKEN_LEFT_BRACKET;
-            token.content = make_token_content(parser, 1);
-            parser->current_pos += 1;
-        } else if (c == ']') {
-            token.kind    = TOKEN_RIGHT_BRACKET;
-            token.content = make_token_content(parser, 1);
-            parser->current_pos += 1;
-        } else if (c == '=') {
-            token.kind    = TOKEN_EQUAL;
-            token.content = make_token_content(parser, 1);
-            parser->current_pos += 1;
-        } else if (c == '\n' || c == '\r') {
-            u32 const multi_new_line = '\n' + '\r';
-
-            parser->current_pos += 1;
-
-            u8 c2;
-            if (peek_char(parser, &c2) && (c + c2) == multi_new_line) {
-                parser->current_pos += 1;
-            }
-            parser->current_line += 1;
-            token.kind    = TOKEN_NEW_LINE;
-        } else if (c == ';') {
-            token = parse_comment(parser);
-        } else if (c == '"') {
-            token = parse_quoted_string(parser);
+            // NOTE: Only the rest of the line is lost, the next line is parsed again.
+            length = find_first_of(rest_of_input(parser, at), '\n', '\r');
+            if (length == -1) length = parser->input_end - at;
+            at += length;
         } else {
-            token = parse_string(parser);
+            token.kind    = TOKEN_STRING;
+            token.content = {at, length};
+            at += length + 1;
         }
-    } else {
-        token.kind = TOKEN_END_OF_INPUT;
-        parser->status = PARSE_END;
+    } break;
+
+    default: {
+        u8 *start = at;
+        while (at < parser->input_end && CharClasses.classes[*at] <= CHAR_WHITESPACE) {
+            at += 1;
+        }
+
+        token.kind    = TOKEN_STRING;
+        token.content = trim({start, at - start});
+    }
     }
 
+    parser->at = at;
+
     return token;
 }
 
 INTERNAL Parser init_parser(String source) {
     Parser parser = {};
-    parser.source = source;
+    parser.source    = source;
+    parser.at        = begin(source);
+    parser.input_end = end(source);
 
     parser.current_token = next_token(&parser);
 
     return parser;
 }
 
+INTERNAL void error(Parser *parser, String message) {
+    parser->status        = PARSE_ERROR;
+    parser->error_line    = parser->current_token.line;
+    parser->error_message = message;
+}
+
 INTERNAL void advance_token(Parser *parser) {
     parser->previous_token = parser->current_token;
     parser->current_token  = next_token(parser);
+
+    if (parser->current_token.kind == TOKEN_ERROR) {
+        error(parser, parser->current_token.content);
+    }
 }
 
 INTERNAL b32 match(Parser *parser, TokenKind kind) {
@@ -217,15 +226,36 @@ INTERNAL b32 match(Parser *parser, TokenKind kind) {
 }
 
 INTERNAL b32 consume(Parser *parser, TokenKind kind, String message) {
+    if (parser->status == PARSE_ERROR) return false;
+
     if (!match(parser, kind)) {
-        parser->current_token.kind    = TOKEN_ERROR;
-        parser->current_token.content = message;
-        parser->status = PARSE_ERROR;
+        error(parser, message);
 
         return false;
     }
 
-    return true;
+    return parser->status != PARSE_ERROR;
+}
+
+// NOTE: Drops everything up to the next line so one broken line does not take
+//       the rest of the file with it.
+INTERNAL void recover(Parser *parser) {
+    TokenKind kind = parser->current_token.kind;
+    while (kind != TOKEN_NEW_LINE && kind != TOKEN_END_OF_INPUT) {
+        advance_token(parser);
+        kind = parser->current_token.kind;
+    }
+
+    if (kind == TOKEN_NEW_LINE) advance_token(parser);
+
+    parser->status = parser->current_token.kind == TOKEN_END_OF_INPUT ? PARSE_END : PARSE_OK;
+    if (parser->current_token.kind == TOKEN_ERROR) error(parser, parser->current_token.content);
+}
+
+INTERNAL b32 at_end_of_line(Parser *parser) {
+    TokenKind kind = parser->current_token.kind;
+
+    return kind == TOKEN_NEW_LINE || kind == TOKEN_COMMENT || kind == TOKEN_END_OF_INPUT;
 }
 
 INTERNAL void parse_section(Parser *parser, Configuration *config) {
@@ -236,169 +266,728 @@ INTERNAL void parse_section(Parser *parser, Configuration *config) {
 
     Token name = parser->previous_token;
     if (!consume(parser, TOKEN_RIGHT_BRACKET, "Missing closing ] in section declaration.")) return;
+    if (!at_end_of_line(parser)) {
+        error(parser, "Unexpected token after section declaration.");
+        return;
+    }
 
     // TODO: Check for duplicates.
-    section.name = allocate_string(name.content, config->allocator);
+    section.name_atom = intern(&config->atoms, name.content);
+    section.name      = atom_string(&config->atoms, section.name_atom);
+    section.lines.allocator = config->allocator;
     parser->current_section = append(&config->sections, section);
 
     match(parser, TOKEN_NEW_LINE);
 }
 
+// NOTE: Values and comments are not copied, they point into the source.
 INTERNAL void parse_entry(Parser *parser, Configuration *config) {
     if (!consume(parser, TOKEN_STRING, "Expected key.")) return;
     String key_token = parser->previous_token.content;
 
     if (!consume(parser, TOKEN_EQUAL, "Expected = .")) return;
 
-    String value_token = {};
-    if (parser->current_token.kind != TOKEN_NEW_LINE) {
+    String value = {};
+    if (!at_end_of_line(parser)) {
         if (!consume(parser, TOKEN_STRING, "Expected value.")) return;
-        value_token = parser->previous_token.content;
+        value = parser->previous_token.content;
     }
 
-    String key     = allocate_string(key_token, config->allocator);
-    String value   = allocate_string(value_token, config->allocator);
     String comment = {};
     if (match(parser, TOKEN_COMMENT)) {
-        comment = allocate_string(parser->previous_token.content, config->allocator);
+        comment = parser->previous_token.content;
+    }
+    if (!at_end_of_line(parser)) {
+        error(parser, "Unexpected token after value.");
+        return;
     }
 
-    append(&parser->current_section->lines, {key, value, comment});
+    Atom   key_atom = intern(&config->atoms, key_token);
+    String key      = atom_string(&config->atoms, key_atom);
+    append(&parser->current_section->lines, {key_atom, key, value, comment});
 
     match(parser, TOKEN_NEW_LINE);
 }
 
 INTERNAL void parse_comment(Parser *parser, Configuration *config) {
     if (!consume(parser, TOKEN_COMMENT, "Expected comment.")) return;
-    String comment = allocate_string(parser->previous_token.content, config->allocator);
+    String comment = parser->previous_token.content;
 
-    append(&parser->current_section->lines, {{}, {}, comment});
+    append(&parser->current_section->lines, {NoAtom, {}, {}, comment});
 
     match(parser, TOKEN_NEW_LINE);
 }
 
-b32 init(Configuration *config, String file_name, Allocator alloc) {
-    PlatformReadResult read_result = platform_read_entire_file(file_name);
-    DEFER(destroy(&read_result.content));
-    
-    if (read_result.error != PLATFORM_READ_OK) return false;
-    Parser parser = init_parser(read_result.content);
+b32 init(Configuration *config, String file_name, Allocator alloc, b32 copy_source) {
+    PlatformMappedFile source = {};
+    String content = {};
 
-    // TODO: This can be just a reset.
-    destroy(config);
-    config->allocator = alloc;
-    config->file_name = allocate_string(file_name, alloc);
+    if (copy_source) {
+        PlatformReadResult read_result = platform_read_entire_file(file_name, alloc);
+        if (read_result.error) return false;
 
-    ConfigurationSection empty = {}; // NOTE: Ambiguous call otherwise.
-    parser.current_section = append(&config->sections, empty);
-
-    while (parser.status != PARSE_END) {
-        switch (parser.current_token.kind) {
-        case TOKEN_LEFT_BRACKET: {
-            parse_section(&parser, config);
-        } break;
+        content = read_result.content;
+    } else {
+        source = platform_map_entire_file(file_name);
+        if (source.error != PLATFORM_READ_OK) return false;
 
-        case TOKEN_STRING: {
-            parse_entry(&parser, config);
-        } break;
+        content = source.content;
+    }
 
-        case TOKEN_COMMENT: {
-            parse_comment(&parser, config);
-        } break;
+    Parser parser = init_parser(content);
 
-        case TOKEN_NEW_LINE: {
-            advance_token(&parser);
-            append(&parser.current_section->lines, {{}, {}, {}});
-        } break;
+    // TODO: This can be just a reset.
+    destroy(config);
+    config->allocator   = alloc;
+    config->file_name   = allocate_string(file_name, alloc);
+    config->source      = source;
+    config->source_copy = copy_source ? content : String{};
+    config->sections.allocator = alloc;
+    config->errors.allocator   = alloc;
+    init(&config->atoms, alloc);
 
-        case TOKEN_END_OF_INPUT: {
-            parser.status = PARSE_END;
-        } break;
+    ConfigurationSection empty = {}; // NOTE: Ambiguous call otherwise.
+    empty.name_atom = intern(&config->atoms, {});
+    empty.lines.allocator = alloc;
+    parser.current_section = append(&config->sections, empty);
 
-        default:
-            parser.current_token.kind    = TOKEN_ERROR;
-            parser.current_token.content = "Unexpected token.";
+    if (parser.current_token.kind == TOKEN_ERROR) error(&parser, parser.current_token.content);
 
-            parser.status = PARSE_ERROR;
+    while (parser.status != PARSE_END) {
+        if (parser.status == PARSE_OK) {
+            switch (parser.current_token.kind) {
+            case TOKEN_LEFT_BRACKET: {
+                parse_section(&parser, config);
+            } break;
+
+            case TOKEN_STRING: {
+                parse_entry(&parser, config);
+            } break;
+
+            case TOKEN_COMMENT: {
+                parse_comment(&parser, config);
+            } break;
+
+            case TOKEN_NEW_LINE: {
+                advance_token(&parser);
+                append(&parser.current_section->lines, {NoAtom, {}, {}, {}});
+            } break;
+
+            case TOKEN_END_OF_INPUT: {
+                parser.status = PARSE_END;
+            } break;
+
+            default:
+                error(&parser, "Unexpected token.");
+            }
         }
 
-        // TODO: Better error handling and recovery.
-        //       Just because there is an error on one line it should not stop working.
+        // NOTE: Errors are collected and the parser continues with the next line.
         if (parser.status == PARSE_ERROR) {
-            Token error = parser.current_token;
-            print("Error while loading configuration.\n%S:%d: %S\n\n", file_name, error.line + 1, error.content);
+            ConfigurationError error = {parser.error_line + 1, parser.error_message};
+            append(&config->errors, error);
+
+            print("Error while loading configuration.\n%S:%d: %S\n\n", file_name, error.line, error.message);
 
-            advance_token(&parser);
-            parser.status = PARSE_OK;
+            recover(&parser);
         }
     }
 
+    build_index(config);
+
     return true;
 }
 
 void destroy(Configuration *config) {
     if (config->allocator.allocate) {
         FOR (config->sections, section) {
-            FOR (section->lines, line) {
-                destroy(&line->key);
-                destroy(&line->value);
-                destroy(&line->comment);
-            }
-
             destroy(&section->lines);
-            destroy(&section->name);
         }
 
         destroy(&config->sections);
         destroy(&config->file_name);
+        destroy(&config->errors);
+        platform_unmap_file(&config->source);
+        destroy(&config->source_copy, config->allocator);
+        destroy(&config->atoms);
+        destroy(&config->section_index);
+        destroy(&config->entry_index);
     }
 
     INIT_STRUCT(&config->allocator);
 }
 
-ConfigurationSection *find_section(Configuration *config, String section_name) {
+INTERNAL u64 entry_index_key(Atom section, Atom key) {
+    return ((u64)section << 32) | key;
+}
+
+INTERNAL u64 section_hash(ConfigurationSection *section) {
+    u64 h = 0x100;
+
+    FOR (section->lines, line) {
+        String parts[] = {line->key, line->value, line->comment};
+        for (s64 i = 0; i < (s64)C_ARRAY_SIZE(parts); i += 1) {
+            h ^= basic_hash(&parts[i]);
+            h *= 1111111111111111111u;
+        }
+    }
+
+    return h;
+}
+
+void build_index(Configuration *config) {
+    s32 const min_exponent = 6;
+
+    // NOTE: Keep the load of the tables below the growth threshold from the start.
+    s64 line_count = 0;
     FOR (config->sections, section) {
-        if (section->name == section_name) return section;
+        line_count += section->lines.size;
     }
+    s32 exponent = min_exponent;
+    while ((1LL << exponent) * 0.6f < line_count + 1) exponent += 1;
+
+    destroy(&config->section_index);
+    destroy(&config->entry_index);
+    init(&config->section_index, min_exponent, config->allocator);
+    init(&config->entry_index, exponent, config->allocator);
+
+    FOR (config->sections, section) {
+        s32 section_index = (s32)FOR_INDEX(config->sections, section);
+        section->hash = section_hash(section);
+
+        // NOTE: Only the first section of a name is visible, same for the keys in it.
+        if (!insert(&config->section_index, section->name_atom, section_index)) continue;
+
+        FOR (section->lines, line) {
+            if (line->key_atom == NoAtom) continue;
+
+            ConfigurationEntryIndex index = {section_index, (s32)FOR_INDEX(section->lines, line)};
+            insert(&config->entry_index, entry_index_key(section->name_atom, line->key_atom), index);
+        }
+    }
+}
+
+ConfigurationSection *find_section(Configuration *config, Atom section_name) {
+    s32 *index = find(&config->section_index, section_name);
+    if (index) return &config->sections[*index];
+
+    return 0;
+}
+
+INTERNAL ConfigurationLine *find_line(Configuration *config, String section, String key) {
+    // NOTE: Strings that were never interned can't be part of the config at all.
+    Atom section_atom = find_atom(&config->atoms, section);
+    Atom key_atom     = find_atom(&config->atoms, key);
+    if (section_atom == NoAtom || key_atom == NoAtom) return 0;
+
+    ConfigurationEntryIndex *index = find(&config->entry_index, entry_index_key(section_atom, key_atom));
+    if (index) return &config->sections[index->section].lines[index->line];
 
     return 0;
 }
 
 String entry_string(Configuration *config, String section, String key, String def) {
-    String result = def;
+    ConfigurationLine *line = find_line(config, section, key);
+    if (line) return line->value;
+
+    return def;
+}
+
+s64 entry_s64(Configuration *config, String section, String key, s64 def) {
+    ConfigurationLine *line = find_line(config, section, key);
+    if (line) return to_s64(line->value);
+
+    return def;
+}
+
+r32 entry_r32(Configuration *config, String section, String key, r32 def) {
+    ConfigurationLine *line = find_line(config, section, key);
+    if (line) return to_r32(line->value);
+
+    return def;
+}
+
+
+//===============================================
+// Compiled layout, everything little endian:
+//
+// header   magic, version, source hash and size (u64),
+//          counts, table offsets, file size
+// sections name, first line, line count, reserved (u32 each)
+// lines    key, value, comment (u32 string offsets)
+// index    hash (u64), line + 1, section (u32), 0 = empty slot
+// strings  written with write_binary_string
+//
+// String offsets are relative to the string table,
+// offset 0 always holds the empty string.
+//===============================================
+u32 const CompiledMagic   = 'M' | ('C' << 8) | ('F' << 16) | ('G' << 24);
+u32 const CompiledVersion = 2;
+
+s64 const CompiledHeaderSize  = 56;
+s64 const CompiledSectionSize = 16;
+s64 const CompiledLineSize    = 12;
+s64 const CompiledSlotSize    = 16;
+
+INTERNAL u64 compiled_entry_hash(String section, String key) {
+    u64 h = basic_hash(&section);
+    h ^= basic_hash(&key) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+
+    return h;
+}
+
+struct CompiledStringTable {
+    StringBuilder builder;
+    HashTable<String, u32> offsets;
+};
+
+INTERNAL u32 add_string(CompiledStringTable *table, String str) {
+    u32 *existing = find(&table->offsets, str);
+    if (existing) return *existing;
+
+    u32 offset = (u32)table->builder.total_size;
+    write_binary_string(&table->builder, str);
+    insert(&table->offsets, str, offset);
+
+    return offset;
+}
+
+struct CompiledSlot {
+    u64 hash;
+    u32 line; // NOTE: Plus one, 0 marks an empty slot.
+    u32 section;
+};
+
+INTERNAL String source_content(Configuration *config) {
+    return config->source_copy.size ? config->source_copy : config->source.content;
+}
+
+INTERNAL void build_compiled_configuration(Configuration *config, StringBuilder *builder) {
+    CompiledStringTable strings = {};
+    DEFER(destroy(&strings.builder); destroy(&strings.offsets));
+    add_string(&strings, {});
+
+    u32 line_count = 0;
+    FOR (config->sections, section) {
+        line_count += (u32)section->lines.size;
+    }
+
+    // NOTE: At most half full so the probing stays short.
+    u32 index_size = 16;
+    while (index_size < config->entry_index.used * 2) index_size *= 2;
+
+    Array<CompiledSlot> slots = array_allocate<CompiledSlot>(index_size);
+    DEFER(array_destroy(&slots));
+    zero_memory(slots.data, index_size * sizeof(CompiledSlot));
+
+    Array<u32> first_lines = array_allocate<u32>(config->sections.size);
+    DEFER(array_destroy(&first_lines));
+
+    // NOTE: The string table is filled first, its size is part of the header.
+    u32 next_line = 0;
+    FOR (config->sections, section) {
+        first_lines[FOR_INDEX(config->sections, section)] = next_line;
+        next_line += (u32)section->lines.size;
+
+        add_string(&strings, section->name);
+        FOR (section->lines, line) {
+            add_string(&strings, line->key);
+            add_string(&strings, line->value);
+            add_string(&strings, line->comment);
+        }
+    }
+
+    for (s64 i = 0; i < config->entry_index.alloc; i += 1) {
+        auto *entry = &config->entry_index.entries[i];
+        if (entry->hash < config->entry_index.FirstValidHash) continue;
+
+        ConfigurationSection *section = &config->sections[entry->value.section];
+        ConfigurationLine    *line    = &section->lines[entry->value.line];
+
+        u64 h = compiled_entry_hash(section->name, line->key);
+        u32 slot = (u32)h & (index_size - 1);
+        while (slots[slot].line) slot = (slot + 1) & (index_size - 1);
+
+        slots[slot].hash    = h;
+        slots[slot].line    = first_lines[entry->value.section] + entry->value.line + 1;
+        slots[slot].section = entry->value.section;
+    }
+
+    u32 section_count   = (u32)config->sections.size;
+    u32 sections_offset = (u32)CompiledHeaderSize;
+    u32 lines_offset    = sections_offset + section_count * (u32)CompiledSectionSize;
+    u32 index_offset    = lines_offset + line_count * (u32)CompiledLineSize;
+    u32 strings_offset  = index_offset + index_size * (u32)CompiledSlotSize;
+
+    String source = source_content(config);
+    write_binary(builder, CompiledMagic);
+    write_binary(builder, CompiledVersion);
+    write_binary(builder, basic_hash(&source));
+    write_binary(builder, (u64)source.size);
+    write_binary(builder, section_count);
+    write_binary(builder, line_count);
+    write_binary(builder, index_size);
+    write_binary(builder, sections_offset);
+    write_binary(builder, lines_offset);
+    write_binary(builder, index_offset);
+    write_binary(builder, strings_offset);
+    write_binary(builder, strings_offset + (u32)strings.builder.total_size);
+    assert(builder->total_size == CompiledHeaderSize);
 
-    ConfigurationSection *sec = find_section(config, section);
-    if (sec) {
-        FOR (sec->lines, line) {
-            if (line->key == key) return line->value;
+    FOR (config->sections, section) {
+        write_binary(builder, add_string(&strings, section->name));
+        write_binary(builder, first_lines[FOR_INDEX(config->sections, section)]);
+        write_binary(builder, (u32)section->lines.size);
+        write_binary(builder, (u32)0);
+    }
+
+    FOR (config->sections, section) {
+        FOR (section->lines, line) {
+            write_binary(builder, add_string(&strings, line->key));
+            write_binary(builder, add_string(&strings, line->value));
+            write_binary(builder, add_string(&strings, line->comment));
         }
     }
 
+    FOR (slots, slot) {
+        write_binary(builder, slot->hash);
+        write_binary(builder, slot->line);
+        write_binary(builder, slot->section);
+    }
+    assert(builder->total_size == strings_offset);
+
+    for (auto *block = &strings.builder.first; block; block = block->next) {
+        append(builder, {block->buffer, block->used});
+    }
+}
+
+// NOTE: Written next to the target and renamed over it. Other processes may have the old file
+//       mapped, truncating it in place would crash them on the next lookup on linux and fails
+//       on win32. A reader only ever sees a complete file, old or new.
+INTERNAL b32 replace_compiled_file(StringBuilder *builder, String file_name) {
+    SCOPE_TEMP_STORAGE();
+
+    String temp_name = t_format("%S.%U.tmp", file_name, (u64)platform_timestamp());
+
+    PlatformFile file = platform_file_open(temp_name, PlatformFileOverride);
+    if (!file.open) return false;
+
+    b32 written = write_builder_to_file(builder, &file);
+    platform_file_close(&file);
+
+    if (written && platform_rename_file(temp_name, file_name)) return true;
+
+    platform_delete_file(temp_name);
+
+    return false;
+}
+
+b32 write_compiled_configuration(Configuration *config, String file_name) {
+    StringBuilder builder = {};
+    DEFER(destroy(&builder));
+
+    build_compiled_configuration(config, &builder);
+
+    return replace_compiled_file(&builder, file_name);
+}
+
+void destroy(CompiledConfiguration *compiled) {
+    platform_unmap_file(&compiled->file);
+    destroy(&compiled->memory);
+
+    INIT_STRUCT(compiled);
+}
+
+INTERNAL b32 table_fits(u32 offset, u32 count, s64 stride, s64 size) {
+    return offset >= CompiledHeaderSize && (u64)offset + (u64)count * (u64)stride <= (u64)size;
+}
+
+// NOTE: Checks the header and that every table lies within data, the content of the tables is checked by the lookups.
+INTERNAL b32 open_compiled_configuration(CompiledConfiguration *compiled, String data, String source_file_name) {
+    // NOTE: The size check catches a file that is cut off or still being written.
+    if (data.size < CompiledHeaderSize ||
+        read_le_u32(data, (s64)0)  != CompiledMagic   ||
+        read_le_u32(data, (s64)4)  != CompiledVersion ||
+        read_le_u32(data, (s64)52) != (u64)data.size) {
+        return false;
+    }
+
+    if (source_file_name.size) {
+        PlatformMappedFile source = platform_map_entire_file(source_file_name);
+        DEFER(platform_unmap_file(&source));
+
+        b32 stale = source.error != PLATFORM_READ_OK ||
+                    read_le_u64(data, (s64)16) != (u64)source.content.size ||
+                    read_le_u64(data, (s64)8)  != basic_hash(&source.content);
+        if (stale) return false;
+    }
+
+    u32 section_count   = read_le_u32(data, (s64)24);
+    u32 line_count      = read_le_u32(data, (s64)28);
+    u32 index_size      = read_le_u32(data, (s64)32);
+    u32 sections_offset = read_le_u32(data, (s64)36);
+    u32 lines_offset    = read_le_u32(data, (s64)40);
+    u32 index_offset    = read_le_u32(data, (s64)44);
+    u32 strings_offset  = read_le_u32(data, (s64)48);
+
+    // NOTE: The index size is used as a mask.
+    b32 valid = index_size && (index_size & (index_size - 1)) == 0 &&
+                table_fits(sections_offset, section_count, CompiledSectionSize, data.size) &&
+                table_fits(lines_offset,    line_count,    CompiledLineSize,    data.size) &&
+                table_fits(index_offset,    index_size,    CompiledSlotSize,    data.size) &&
+                table_fits(strings_offset,  0,             0,                   data.size);
+    if (!valid) return false;
+
+    compiled->data            = data;
+    compiled->section_count   = section_count;
+    compiled->line_count      = line_count;
+    compiled->index_size      = index_size;
+    compiled->sections_offset = sections_offset;
+    compiled->lines_offset    = lines_offset;
+    compiled->index_offset    = index_offset;
+    compiled->strings_offset  = strings_offset;
+
+    return true;
+}
+
+b32 init(CompiledConfiguration *compiled, String file_name, String source_file_name) {
+    destroy(compiled);
+
+    PlatformMappedFile file = platform_map_entire_file(file_name);
+    if (file.error != PLATFORM_READ_OK) return false;
+
+    if (!open_compiled_configuration(compiled, file.content, source_file_name)) {
+        platform_unmap_file(&file);
+
+        return false;
+    }
+    compiled->file = file;
+
+    return true;
+}
+
+b32 load_compiled_configuration(CompiledConfiguration *compiled, String source_file_name, String compiled_file_name) {
+    if (init(compiled, compiled_file_name, source_file_name)) return true;
+
+    // NOTE: Only read once to compile it, so mapping is fine.
+    Configuration config = {};
+    if (!init(&config, source_file_name, DefaultAllocator, false)) return false;
+    DEFER(destroy(&config));
+
+    StringBuilder builder = {};
+    DEFER(destroy(&builder));
+    build_compiled_configuration(&config, &builder);
+
+    if (replace_compiled_file(&builder, compiled_file_name)) {
+        if (init(compiled, compiled_file_name, source_file_name)) return true;
+    }
+
+    // NOTE: The text parsed fine, only the compiled file couldn't be written. Serve the image from memory then.
+    compiled->memory = to_allocated_string(&builder);
+    if (open_compiled_configuration(compiled, compiled->memory, {})) return true;
+
+    destroy(compiled);
+
+    return false;
+}
+
+INTERNAL String compiled_string(CompiledConfiguration *compiled, u32 offset) {
+    String data = compiled->data;
+
+    s64 start = (s64)compiled->strings_offset + offset;
+    if (start >= data.size) return {};
+
+    u64 length = 0;
+    s32 bytes = decode_varint(data.data + start, data.data + data.size, &length);
+    if (bytes == 0 || length > (u64)(data.size - start - bytes)) return {};
+
+    String result = {data.data + start + bytes, (s64)length};
+
     return result;
 }
 
-s64 entry_s64(Configuration *config, String section, String key, s64 def) {
-    s64 result = def;
+INTERNAL String compiled_value(CompiledConfiguration *compiled, String section, String key, b32 *found) {
+    *found = false;
+    if (compiled->index_size == 0) return {};
+
+    String data = compiled->data;
+    u64 h = compiled_entry_hash(section, key);
 
-    ConfigurationSection *sec = find_section(config, section);
-    if (sec) {
-        FOR (sec->lines, line) {
-            if (line->key == key) return to_s64(line->value);
+    // NOTE: A broken file might have no empty slot, the probing stops after every slot was seen once.
+    u32 mask = compiled->index_size - 1;
+    u32 slot = (u32)h & mask;
+    for (u32 probes = 0; probes < compiled->index_size; probes += 1, slot = (slot + 1) & mask) {
+        s64 offset = compiled->index_offset + (s64)slot * CompiledSlotSize;
+
+        u32 line = read_le_u32(data, offset + 8);
+        if (line == 0) return {};
+        if (read_le_u64(data, offset) != h) continue;
+
+        u32 section_index = read_le_u32(data, offset + 12);
+        if (section_index >= compiled->section_count || line > compiled->line_count) continue;
+
+        s64 section_offset = compiled->sections_offset + (s64)section_index * CompiledSectionSize;
+        if (compiled_string(compiled, read_le_u32(data, section_offset)) != section) continue;
+
+        s64 line_offset = compiled->lines_offset + (s64)(line - 1) * CompiledLineSize;
+        if (compiled_string(compiled, read_le_u32(data, line_offset)) != key) continue;
+
+        *found = true;
+
+        return compiled_string(compiled, read_le_u32(data, line_offset + 4));
+    }
+
+    return {};
+}
+
+String entry_string(CompiledConfiguration *compiled, String section, String key, String def) {
+    b32 found;
+    String value = compiled_value(compiled, section, key, &found);
+
+    return found ? value : def;
+}
+
+s64 entry_s64(CompiledConfiguration *compiled, String section, String key, s64 def) {
+    b32 found;
+    String value = compiled_value(compiled, section, key, &found);
+
+    return found ? to_s64(value) : def;
+}
+
+r32 entry_r32(CompiledConfiguration *compiled, String section, String key, r32 def) {
+    b32 found;
+    String value = compiled_value(compiled, section, key, &found);
+
+    return found ? to_r32(value) : def;
+}
+
+
+b32 init(LiveConfiguration *live, String file_name, Allocator alloc) {
+    destroy(live);
+
+    live->allocator = alloc;
+    live->file_name = allocate_string(file_name, alloc);
+    live->retired.allocator     = alloc;
+    live->subscribers.allocator = alloc;
+
+    // NOTE: A missing watcher only means there won't be any automatic reloads.
+    live->watcher = platform_watch_file(file_name, alloc);
+
+    return reload(live);
+}
+
+void destroy(LiveConfiguration *live) {
+    if (live->allocator.allocate) {
+        release_retired_configurations(live);
+
+        Configuration *current = atomic_exchange(&live->current, (Configuration*)0);
+        if (current) {
+            destroy(current);
+            DEALLOC(live->allocator, current, 1);
         }
+
+        platform_unwatch_file(live->watcher);
+        destroy(&live->retired);
+        destroy(&live->subscribers);
+        destroy(&live->file_name);
     }
 
-    return result;
+    INIT_STRUCT(live);
 }
 
-r32 entry_r32(Configuration *config, String section, String key, r32 def) {
-    r32 result = def;
+Configuration *current_configuration(LiveConfiguration *live) {
+    return atomic_load(&live->current);
+}
+
+void subscribe(LiveConfiguration *live, ConfigurationChangeCallback *callback, void *data) {
+    ConfigurationSubscriber subscriber = {callback, data};
+    append(&live->subscribers, subscriber);
+}
+
+INTERNAL void notify(LiveConfiguration *live, Configuration *config, String section) {
+    FOR (live->subscribers, subscriber) {
+        subscriber->callback(subscriber->data, config, section);
+    }
+}
 
-    ConfigurationSection *sec = find_section(config, section);
-    if (sec) {
-        FOR (sec->lines, line) {
-            if (line->key == key) return to_r32(line->value);
+INTERNAL ConfigurationSection *find_section(Configuration *config, String name) {
+    Atom atom = find_atom(&config->atoms, name);
+    if (atom == NoAtom) return 0;
+
+    return find_section(config, atom);
+}
+
+// NOTE: Only the first section of a name counts, the same as for the lookups.
+INTERNAL b32 is_visible(Configuration *config, ConfigurationSection *section) {
+    return find_section(config, section->name_atom) == section;
+}
+
+b32 reload(LiveConfiguration *live) {
+    Configuration *loaded = ALLOC(live->allocator, Configuration, 1);
+    INIT_STRUCT(loaded);
+    if (!init(loaded, live->file_name, live->allocator)) {
+        DEALLOC(live->allocator, loaded, 1);
+
+        return false;
+    }
+
+    Configuration *old = live->current;
+    if (old == 0) {
+        atomic_store(&live->current, loaded);
+
+        return true;
+    }
+
+    b32 changed = loaded->sections.size != old->sections.size;
+    for (s64 i = 0; !changed && i < loaded->sections.size; i += 1) {
+        ConfigurationSection *a = &loaded->sections[i];
+        ConfigurationSection *b = &old->sections[i];
+
+        changed = a->hash != b->hash || a->name != b->name;
+    }
+
+    // NOTE: Saving without changes should not bother anybody.
+    if (!changed) {
+        destroy(loaded);
+        DEALLOC(live->allocator, loaded, 1);
+
+        return true;
+    }
+
+    atomic_store(&live->current, loaded);
+    append(&live->retired, old);
+
+    FOR (loaded->sections, section) {
+        if (!is_visible(loaded, section)) continue;
+
+        ConfigurationSection *previous = find_section(old, section->name);
+        if (previous == 0 || previous->hash != section->hash) {
+            notify(live, loaded, section->name);
         }
     }
 
-    return result;
+    FOR (old->sections, section) {
+        if (!is_visible(old, section)) continue;
+
+        if (find_section(loaded, section->name) == 0) {
+            notify(live, loaded, section->name);
+        }
+    }
+
+    return true;
+}
+
+b32 reload_if_changed(LiveConfiguration *live) {
+    if (live->watcher == 0 || !platform_file_changed(live->watcher)) return false;
+
+    return reload(live);
+}
+
+void release_retired_configurations(LiveConfiguration *live) {
+    FOR (live->retired, config) {
+        destroy(*config);
+        DEALLOC(live->allocator, *config, 1);
+    }
+
+    live->retired.size = 0;
 }
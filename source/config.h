@@ -1,34 +1,163 @@
 #pragma once
 
 #include "list.h"
+#include "atom.h"
+#include "platform.h"
 
 
 // NOTE: These can't be sorted or stored in a hash table as this would destroy ordering
 //       and the file can't be saved in the layout before the read.
+//       The sections and lines stay the source of truth. The hash tables in
+//       Configuration only map atoms to their position for fast lookups and are
+//       rebuilt by build_index() whenever the lists change.
 
+// NOTE: Keys and section names point into the atoms of the Configuration.
+//       Comment and empty lines have a key_atom of NoAtom.
 struct ConfigurationLine {
+    Atom   key_atom;
     String key;
     String value;
     String comment;
 };
 
 struct ConfigurationSection {
+    Atom   name_atom;
     String name;
     List<ConfigurationLine> lines;
+
+    u64 hash; // NOTE: Over all lines, used to find changed sections on reload.
+};
+
+struct ConfigurationEntryIndex {
+    s32 section;
+    s32 line;
 };
 
+struct ConfigurationError {
+    s32    line;
+    String message;
+};
+
+// NOTE: Values and comments point directly into the source. By default that is a copy
+//       the Configuration owns. Without copy_source the file is mapped instead, which only
+//       suits reading it once: a mapped file changes under the Configuration when it is
+//       saved in place, and on win32 it can't be saved at all while it is mapped.
 struct Configuration {
     Allocator allocator;
 
     String file_name;
+    PlatformMappedFile source;
+    String source_copy;
+
     List<ConfigurationSection> sections;
+    List<ConfigurationError>   errors;
+
+    AtomTable atoms;
+
+    // NOTE: Section atom -> index of the first section with that name.
+    HashTable<Atom, s32> section_index;
+    // NOTE: (section atom << 32 | key atom) -> first line with that key.
+    HashTable<u64, ConfigurationEntryIndex> entry_index;
 };
 
 
-b32  init(Configuration *config, String file_name, Allocator alloc = DefaultAllocator);
+b32  init(Configuration *config, String file_name, Allocator alloc = DefaultAllocator, b32 copy_source = true);
 void destroy(Configuration *config);
+void build_index(Configuration *config);
 
 String entry_string(Configuration *config, String section, String key, String def = {});
 s64    entry_s64   (Configuration *config, String section, String key, s64 def = 0);
 r32    entry_r32   (Configuration *config, String section, String key, r32 def = 0.0f);
 
+
+//===============================================
+// The compiled form of a Configuration is a flat
+// binary file that is mapped and used as is, there
+// is no parsing or allocation on load. It contains
+// a string table, a section table, the lines and a
+// hashed index over the visible (section, key) pairs.
+// The checksum of the text source is stored so a
+// stale compiled file can be detected.
+//
+// Only lookups are supported, use the text form for
+// everything else.
+//
+// Nothing in a compiled file is trusted, init checks
+// that every table lies within the file and lookups
+// check the indices and strings they follow.
+//===============================================
+struct CompiledConfiguration {
+    PlatformMappedFile file;
+    String memory; // NOTE: Owned image, when the compiled file couldn't be written.
+    String data;   // NOTE: Either the mapped file or memory.
+
+    u32 section_count;
+    u32 line_count;
+    u32 index_size;
+
+    u32 sections_offset;
+    u32 lines_offset;
+    u32 index_offset;
+    u32 strings_offset;
+};
+
+b32  write_compiled_configuration(Configuration *config, String file_name);
+// NOTE: Fails if source_file_name is given and the file changed since compiling.
+b32  init(CompiledConfiguration *compiled, String file_name, String source_file_name = {});
+void destroy(CompiledConfiguration *compiled);
+// NOTE: Uses the compiled file if it is up to date, otherwise parses the source and writes it anew.
+//       If writing fails (read only folder, full disk) the compiled form is kept in memory.
+b32  load_compiled_configuration(CompiledConfiguration *compiled, String source_file_name, String compiled_file_name);
+
+String entry_string(CompiledConfiguration *compiled, String section, String key, String def = {});
+s64    entry_s64   (CompiledConfiguration *compiled, String section, String key, s64 def = 0);
+r32    entry_r32   (CompiledConfiguration *compiled, String section, String key, r32 def = 0.0f);
+
+
+//===============================================
+// A LiveConfiguration reloads the file whenever it
+// changes on disk. Every successful reload creates
+// a new Configuration (a snapshot) that is never
+// modified after it is published, so readers on
+// any thread can keep using the snapshot they got
+// from current_configuration() together with all
+// the Strings inside it. Snapshots own a copy of
+// the file, writing to it doesn't touch them.
+//
+// Replaced snapshots are only retired. They are
+// freed by release_retired_configurations() which
+// the owner calls at a point where no reader holds
+// an old snapshot anymore (e.g. between frames).
+//
+// Subscribers are called from reload_if_changed()
+// once for every section that was added, removed
+// or has different lines than before.
+//===============================================
+typedef void ConfigurationChangeCallback(void *data, Configuration *config, String section);
+struct ConfigurationSubscriber {
+    ConfigurationChangeCallback *callback;
+    void *data;
+};
+
+struct LiveConfiguration {
+    Allocator allocator;
+
+    String file_name;
+    PlatformFileWatcher *watcher;
+
+    Configuration *volatile current;
+    List<Configuration*> retired;
+
+    List<ConfigurationSubscriber> subscribers;
+};
+
+b32  init(LiveConfiguration *live, String file_name, Allocator alloc = DefaultAllocator);
+void destroy(LiveConfiguration *live);
+
+Configuration *current_configuration(LiveConfiguration *live);
+void subscribe(LiveConfiguration *live, ConfigurationChangeCallback *callback, void *data = 0);
+
+b32  reload_if_changed(LiveConfiguration *live);
+b32  reload(LiveConfiguration *live);
+void release_retired_configurations(LiveConfiguration *live);
+
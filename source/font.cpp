@@ -10,6 +10,11 @@
 #define STBTT_assert
 #include "stb_truetype.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FONT_USE_SSE2
+#include <emmintrin.h>
+#endif
+
 
 struct CachedGlyph {
     r32 u0, v0, u1, v1;
@@ -23,6 +28,7 @@ INTERNAL CachedGlyph *load_glyph(Font *font, u32 cp);
 
 b32 init(Font *font, String file_name, r32 height, s32 atlas_size, Allocator alloc) {
     destroy(font); // NOTE: Checks for initialised font anyway.
+    font->allocator = alloc;
 
     PlatformReadResult read_result = platform_read_entire_file(file_name, font->allocator);
     if (read_result.error) {
@@ -32,6 +38,7 @@ b32 init(Font *font, String file_name, r32 height, s32 atlas_size, Allocator all
     }
 
     String ttf = read_result.content;
+    font->file_content = ttf;
 
     stbtt_fontinfo stb = {};
     stbtt_InitFont(&stb, ttf.data, stbtt_GetFontOffsetForIndex(ttf.data, 0));
@@ -62,6 +69,8 @@ b32 init(Font *font, String file_name, r32 height, s32 atlas_size, Allocator all
     font->info  = stb;
     font->scale = scale;
 
+    init(&font->glyphs, 7, alloc);
+
     // TODO: Currently only loading the ascii characters.
     //       Depending on the language should other characters be cached?
     for (s32 i = 32; i < 127; i += 1) {
@@ -73,9 +82,11 @@ b32 init(Font *font, String file_name, r32 height, s32 atlas_size, Allocator all
 
 void destroy(Font *font) {
     if (font->allocator.allocate) {
-        destroy(&font->file_content);
-        destroy(&font->atlas);
+        destroy(&font->file_content, font->allocator);
+        destroy(&font->atlas, font->allocator);
         destroy(&font->glyphs);
+
+        INIT_STRUCT(font);
     }
 }
 
@@ -91,6 +102,252 @@ INTERNAL void copy_image(String atlas, s32 stride, s32 x, s32 y, u8 *bitmap, s32
     }
 }
 
+//================================================
+// Signed distance fields of glyphs.
+// stbtt_GetGlyphSDF measures every pixel against
+// every edge of the outline, which makes a glyph
+// miss expensive. Instead the glyph is rasterized
+// FONT_SDF_OVERSAMPLING times larger and the exact
+// euclidean distance transform (Felzenszwalb and
+// Huttenlocher) of the samples is taken in linear
+// time, once towards the inside and once towards
+// the outside.
+//
+// The column pass handles eight columns at a time
+// with SSE2. The row pass, the lower envelope of
+// parabolas, only runs on the rows through pixel
+// centers. Distances are capped where the values
+// saturate anyway. The result has the same box,
+// offsets and value mapping as stbtt_GetGlyphSDF,
+// so the atlas is unchanged.
+//================================================
+
+#ifndef FONT_SDF_OVERSAMPLING
+#define FONT_SDF_OVERSAMPLING 3 // NOTE: Has to be odd, so a sample lies on every pixel center.
+#endif
+
+// NOTE: Distance of every sample to the closest inside and the closest outside sample in its column, up to limit.
+//       Samples with a coverage of at least 128 are inside.
+INTERNAL void column_distances(u8 *coverage, s16 *inside, s16 *outside, s32 stride, s32 height, s16 limit) {
+    s32 x = 0;
+
+#ifdef FONT_USE_SSE2
+    __m128i zero      = _mm_setzero_si128();
+    __m128i one       = _mm_set1_epi16(1);
+    __m128i maximum   = _mm_set1_epi16(limit);
+    __m128i threshold = _mm_set1_epi16(127);
+
+    for (; x + 8 <= stride; x += 8) {
+        __m128i to_inside  = maximum;
+        __m128i to_outside = maximum;
+        for (s32 y = 0; y < height; y += 1) {
+            __m128i samples   = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)&coverage[y * stride + x]), zero);
+            __m128i is_inside = _mm_cmpgt_epi16(samples, threshold);
+
+            to_inside  = _mm_andnot_si128(is_inside, _mm_min_epi16(_mm_add_epi16(to_inside,  one), maximum));
+            to_outside = _mm_and_si128   (is_inside, _mm_min_epi16(_mm_add_epi16(to_outside, one), maximum));
+
+            _mm_storeu_si128((__m128i*)&inside [y * stride + x], to_inside);
+            _mm_storeu_si128((__m128i*)&outside[y * stride + x], to_outside);
+        }
+
+        for (s32 y = height - 2; y >= 0; y -= 1) {
+            __m128i *inside_here  = (__m128i*)&inside [y * stride + x];
+            __m128i *outside_here = (__m128i*)&outside[y * stride + x];
+
+            to_inside  = _mm_add_epi16(_mm_loadu_si128((__m128i*)&inside [(y + 1) * stride + x]), one);
+            to_outside = _mm_add_epi16(_mm_loadu_si128((__m128i*)&outside[(y + 1) * stride + x]), one);
+
+            _mm_storeu_si128(inside_here,  _mm_min_epi16(_mm_loadu_si128(inside_here),  to_inside));
+            _mm_storeu_si128(outside_here, _mm_min_epi16(_mm_loadu_si128(outside_here), to_outside));
+        }
+    }
+#endif
+
+    for (; x < stride; x += 1) {
+        s16 to_inside  = limit;
+        s16 to_outside = limit;
+        for (s32 y = 0; y < height; y += 1) {
+            b32 is_inside = coverage[y * stride + x] >= 128;
+
+            if (is_inside)               to_inside = 0;
+            else if (to_inside < limit)  to_inside += 1;
+
+            if (!is_inside)              to_outside = 0;
+            else if (to_outside < limit) to_outside += 1;
+
+            inside [y * stride + x] = to_inside;
+            outside[y * stride + x] = to_outside;
+        }
+
+        for (s32 y = height - 2; y >= 0; y -= 1) {
+            s16 below_inside  = inside [(y + 1) * stride + x] + 1;
+            s16 below_outside = outside[(y + 1) * stride + x] + 1;
+
+            if (below_inside  < inside [y * stride + x]) inside [y * stride + x] = below_inside;
+            if (below_outside < outside[y * stride + x]) outside[y * stride + x] = below_outside;
+        }
+    }
+}
+
+struct FontSDFEnvelope {
+    s32 *vertices;
+    r32 *offsets;     // NOTE: Height of the parabola plus its vertex squared.
+    r32 *bounds;
+    r32 *reciprocals; // NOTE: 1 / 2d, saves a division for every intersection.
+};
+
+// NOTE: Squared distances of a row from its column distances, evaluated at first, first + step and so on.
+//       Columns at the limit are left out, they are too far away to matter.
+INTERNAL void row_distances(FontSDFEnvelope *envelope, s16 *columns, s32 count, s16 limit, r32 *result, s32 first, s32 step) {
+    s32 *v = envelope->vertices;
+    r32 *a = envelope->offsets;
+    r32 *z = envelope->bounds;
+
+    s32 k = -1;
+    for (s32 q = 0; q < count; q += 1) {
+        if (columns[q] >= limit) continue;
+
+        r32 offset = (r32)columns[q] * columns[q] + (r32)q * q;
+
+        r32 s = -1e30f;
+        while (k >= 0) {
+            s = (offset - a[k]) * envelope->reciprocals[q - v[k]];
+            if (s > z[k]) break;
+
+            k -= 1;
+            s = -1e30f;
+        }
+
+        k += 1;
+        v[k] = q;
+        a[k] = offset;
+        z[k] = s;
+    }
+
+    r32 none = (r32)limit * limit;
+    if (k < 0) {
+        for (s32 q = first, i = 0; q < count; q += step, i += 1) {
+            result[i] = none;
+        }
+
+        return;
+    }
+
+    s32 last = k;
+    k = 0;
+    for (s32 q = first, i = 0; q < count; q += step, i += 1) {
+        while (k < last && z[k + 1] < q) k += 1;
+
+        r32 distance = (r32)q * q - 2.0f * q * v[k] + a[k];
+        result[i] = distance < none ? distance : none;
+    }
+}
+
+u8 *glyph_sdf(stbtt_fontinfo *info, r32 scale, s32 glyph, s32 padding, u8 onedge, r32 pixel_dist_scale, s32 *width, s32 *height, s32 *x_offset, s32 *y_offset, Allocator alloc) {
+    s32 const S = FONT_SDF_OVERSAMPLING;
+
+    int x0, y0, x1, y1;
+    stbtt_GetGlyphBitmapBoxSubpixel(info, glyph, scale, scale, 0, 0, &x0, &y0, &x1, &y1);
+    if (x0 == x1 || y0 == y1) return 0;
+
+    x0 -= padding;
+    y0 -= padding;
+    x1 += padding;
+    y1 += padding;
+
+    s32 w = x1 - x0;
+    s32 h = y1 - y0;
+
+    // NOTE: The samples cover the padded box S times larger, the stride is a multiple of eight for the column pass.
+    s32 sample_width  = w * S;
+    s32 sample_height = h * S;
+    s32 stride        = (sample_width + 7) & ~7;
+    s64 samples       = (s64)stride * sample_height;
+
+    // NOTE: Past this many samples every value is clamped to 0 or 255.
+    r32 reach = (onedge > 255 - onedge ? onedge : 255 - onedge) / pixel_dist_scale;
+    s16 limit = (s16)((reach + 1) * S);
+
+    u8  *coverage        = ALLOC(alloc, u8,  samples);
+    s16 *columns_inside  = ALLOC(alloc, s16, samples);
+    s16 *columns_outside = ALLOC(alloc, s16, samples);
+    r32 *inside  = ALLOC(alloc, r32, w);
+    r32 *outside = ALLOC(alloc, r32, w);
+
+    FontSDFEnvelope envelope;
+    envelope.vertices    = ALLOC(alloc, s32, sample_width);
+    envelope.offsets     = ALLOC(alloc, r32, sample_width);
+    envelope.bounds      = ALLOC(alloc, r32, sample_width);
+    envelope.reciprocals = ALLOC(alloc, r32, sample_width);
+
+    DEFER(
+        DEALLOC(alloc, coverage, samples);
+        DEALLOC(alloc, columns_inside, samples);
+        DEALLOC(alloc, columns_outside, samples);
+        DEALLOC(alloc, inside, w);
+        DEALLOC(alloc, outside, w);
+        DEALLOC(alloc, envelope.vertices, sample_width);
+        DEALLOC(alloc, envelope.offsets, sample_width);
+        DEALLOC(alloc, envelope.bounds, sample_width);
+        DEALLOC(alloc, envelope.reciprocals, sample_width);
+    );
+
+    envelope.reciprocals[0] = 0;
+    for (s32 i = 1; i < sample_width; i += 1) {
+        envelope.reciprocals[i] = 0.5f / i;
+    }
+
+    memset(coverage, 0, samples);
+
+    // NOTE: The larger box is not exactly S times the small one, the outline is placed where it belongs.
+    int sx0, sy0, sx1, sy1;
+    stbtt_GetGlyphBitmapBoxSubpixel(info, glyph, scale * S, scale * S, 0, 0, &sx0, &sy0, &sx1, &sy1);
+
+    s32 outline_x = sx0 - x0 * S;
+    s32 outline_y = sy0 - y0 * S;
+    s32 outline_w = sx1 - sx0;
+    s32 outline_h = sy1 - sy0;
+    if (outline_x + outline_w > sample_width)  outline_w = sample_width  - outline_x;
+    if (outline_y + outline_h > sample_height) outline_h = sample_height - outline_y;
+
+    if (outline_x >= 0 && outline_y >= 0 && outline_w > 0 && outline_h > 0) {
+        u8 *target = &coverage[outline_y * stride + outline_x];
+        stbtt_MakeGlyphBitmapSubpixel(info, target, outline_w, outline_h, stride, scale * S, scale * S, 0, 0, glyph);
+    }
+
+    u8 *bitmap = ALLOC(alloc, u8, (s64)w * h);
+
+    column_distances(coverage, columns_inside, columns_outside, stride, sample_height, limit);
+
+    for (s32 y = 0; y < h; y += 1) {
+        s32 sample_y = y * S + S / 2;
+        row_distances(&envelope, &columns_inside [sample_y * stride], sample_width, limit, inside,  S / 2, S);
+        row_distances(&envelope, &columns_outside[sample_y * stride], sample_width, limit, outside, S / 2, S);
+
+        // NOTE: The outline lies between a sample and its closest feature, half a sample from the feature.
+        u8 *coverage_row = &coverage[sample_y * stride];
+        for (s32 x = 0; x < w; x += 1) {
+            r32 distance;
+            if (coverage_row[x * S + S / 2] >= 128) distance =  (sqrtf(outside[x]) - 0.5f) / S;
+            else                                    distance = -(sqrtf(inside[x])  - 0.5f) / S;
+
+            r32 value = onedge + distance * pixel_dist_scale;
+            if (value < 0)   value = 0;
+            if (value > 255) value = 255;
+
+            bitmap[y * w + x] = (u8)value;
+        }
+    }
+
+    *width    = w;
+    *height   = h;
+    *x_offset = x0;
+    *y_offset = y0;
+
+    return bitmap;
+}
+
 INTERNAL CachedGlyph *load_glyph(Font *font, u32 cp) {
     CachedGlyph *result = 0;
 
@@ -104,8 +361,8 @@ INTERNAL CachedGlyph *load_glyph(Font *font, u32 cp) {
         int h = 0;
         int x_offset = 0;
         int y_offset = 0;
-        u8 *bitmap = stbtt_GetGlyphSDF(&font->info, font->scale, glyph, 4, 180, 36, &w, &h, &x_offset, &y_offset);
-        DEFER(stbtt_FreeSDF(bitmap, 0));
+        u8 *bitmap = glyph_sdf(&font->info, font->scale, glyph, 4, 180, 36, &w, &h, &x_offset, &y_offset, DefaultAllocator);
+        DEFER(if (bitmap) DEALLOC(DefaultAllocator, bitmap, (s64)w * h));
 
         s32 x = (font->cache_used % font->glyph_columns) * font->glyph_width;
         s32 y = (font->cache_used / font->glyph_columns) * font->glyph_height;
@@ -183,16 +440,26 @@ FontDimensions text_dimensions(Font *font, String text, r32 height, b32 floor_ad
     // NOTE: Empty strings should still have a height.
     s32 lines = 1;
 
-    for (auto it = make_utf8_it(text); it.valid; next(&it)) {
-        CachedGlyph *glyph = find(&font->glyphs, it.cp);
-        if (glyph) glyph = load_glyph(font, it.cp);
+    u32 codepoints[UTF8DecodeBlockSize];
+    while (text.size) {
+        UTF8DecodeResult block = decode_utf8_block(text, codepoints, UTF8DecodeBlockSize);
+
+        for (s64 i = 0; i < block.count; i += 1) {
+            u32 cp = codepoints[i];
 
-        r32 advance = glyph->advance * factor;
-        if (floor_advance) advance = floor(advance);
+            CachedGlyph *glyph = find(&font->glyphs, cp);
+            if (!glyph) glyph = load_glyph(font, cp);
 
-        dimensions.width += (s32)advance;
+            r32 advance = glyph->advance * factor;
+            if (floor_advance) advance = floor(advance);
+
+            dimensions.width += (s32)advance;
+
+            if (cp == '\n') lines += 1;
+        }
 
-        if (it.cp == '\n') lines += 1;
+        if (block.status != UTF_OK) break;
+        text = shrink_front(text, block.bytes);
     }
 
     dimensions.height = metrics.line_height * lines;
@@ -71,3 +71,7 @@ ScaledFontMetrics scaled_line_metrics(Font *font, r32 height);
 GlyphInfo get_glyph(Font *font, u32 cp, r32 height);
 FontDimensions text_dimensions(Font *font, String text, r32 height, b32 floor_advance = false);
 
+// NOTE: Same parameters and result as stbtt_GetGlyphSDF, what load_glyph puts into the atlas.
+//       Returns 0 for empty glyphs like space, otherwise width * height bytes that are freed with DEALLOC.
+u8 *glyph_sdf(stbtt_fontinfo *info, r32 scale, s32 glyph, s32 padding, u8 onedge, r32 pixel_dist_scale, s32 *width, s32 *height, s32 *x_offset, s32 *y_offset, Allocator alloc = DefaultAllocator);
+
@@ -7,6 +7,18 @@ inline u64 basic_hash(u32 *value) {
     return *value;
 }
 
+inline u64 basic_hash(u64 *value) {
+    u64 h = *value;
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+
+    return h;
+}
+
 inline u64 basic_hash(String *str) {
     u64 h = 0x100;
 
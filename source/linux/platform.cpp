@@ -21,6 +21,12 @@
 #include "execinfo.h"
 
 #include "sys/stat.h"
+#include "sys/mman.h"
+#include "sys/inotify.h"
+#include "sys/epoll.h"
+#include "sys/eventfd.h"
+#include <time.h>
+#include <errno.h>
 
 #include "string2.h"
 #include "string_builder.h"
@@ -138,6 +144,24 @@ b32 platform_create_all_folders(String names) {
     return result;
 }
 
+b32 platform_rename_file(String from, String to) {
+    SCOPE_TEMP_STORAGE();
+
+    CString c_from = alloc_c_string(from);
+    CString c_to   = alloc_c_string(to);
+
+    return rename(c_from.data, c_to.data) == 0;
+}
+
+// TODO: Folders are only deleted if they are empty, platform_delete_folder_content is missing.
+b32 platform_delete_file(String path) {
+    SCOPE_TEMP_STORAGE();
+
+    CString c_path = alloc_c_string(path);
+
+    return remove(c_path.data) == 0;
+}
+
 String platform_home_folder(Allocator alloc) {
     passwd *pw = getpwuid(getuid());
 
@@ -203,6 +227,192 @@ PlatformReadResult platform_read_entire_file(String file, Allocator alloc) {
     return result;
 }
 
+PlatformMappedFile platform_map_entire_file(String file) {
+    SCOPE_TEMP_STORAGE();
+
+    PlatformMappedFile result = {};
+
+    CString c_file = alloc_c_string(file);
+    int fd = open(c_file.data, O_RDONLY);
+    if (fd == -1) {
+        result.error = PLATFORM_FILE_NOT_FOUND;
+        return result;
+    }
+    DEFER(close(fd));
+
+    struct stat info = {};
+    if (fstat(fd, &info)) {
+        result.error = PLATFORM_READ_ERROR;
+        return result;
+    }
+
+    if (info.st_size) {
+        void *memory = mmap(0, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (memory == MAP_FAILED) {
+            result.error = PLATFORM_READ_ERROR;
+            return result;
+        }
+
+        result.content = {(u8*)memory, info.st_size};
+        result.handle  = memory;
+    }
+
+    return result;
+}
+
+void platform_unmap_file(PlatformMappedFile *file) {
+    if (file->handle) munmap(file->handle, file->content.size);
+
+    INIT_STRUCT(file);
+}
+
+struct PlatformFileWatcher {
+    Allocator allocator;
+
+    s32 fd;
+    s32 watch;
+
+    // NOTE: inotify reports names relative to the watched folder.
+    String name;
+};
+
+//===============================================
+// Waiting blocks in epoll on everything that can
+// have something new for the application: the
+// terminal input, the file watchers and an eventfd
+// that platform_wakeup writes to. Everything is
+// edge triggered, so data nobody reads doesn't
+// turn the wait into a busy loop.
+//===============================================
+INTERNAL int WaitFd   = -1;
+INTERNAL int WakeupFd = -1;
+
+INTERNAL void add_wait_source(int fd) {
+    if (WaitFd == -1) return;
+
+    epoll_event event = {};
+    event.events  = EPOLLIN | EPOLLET;
+    event.data.fd = fd;
+
+    // NOTE: Fails for regular files and /dev/null, those never block anyway.
+    epoll_ctl(WaitFd, EPOLL_CTL_ADD, fd, &event);
+}
+
+INTERNAL b32 setup_wait() {
+    WaitFd   = epoll_create1(EPOLL_CLOEXEC);
+    WakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (WaitFd == -1 || WakeupFd == -1) return false;
+
+    add_wait_source(WakeupFd);
+    add_wait_source(STDIN_FILENO);
+
+    return true;
+}
+
+void platform_update() {
+    u64 count;
+    while (WakeupFd != -1 && read(WakeupFd, &count, sizeof(count)) > 0);
+}
+
+PlatformWakeReason platform_wait_for_update(s64 timeout_ms) {
+    PlatformWakeReason reason = PLATFORM_WAKE_TIMEOUT;
+
+    if (WaitFd != -1) {
+        s32 const max_events = 16;
+        epoll_event events[max_events];
+
+        int timeout = timeout_ms < 0 ? -1 : (timeout_ms > 0x7FFFFFFF ? 0x7FFFFFFF : (int)timeout_ms);
+        int count = epoll_wait(WaitFd, events, max_events, timeout);
+
+        if (count < 0 && errno == EINTR) reason = PLATFORM_WAKE_SIGNAL;
+
+        // NOTE: Input wins, the application should look at it even if it was also woken up.
+        for (int i = 0; i < count; i += 1) {
+            if (events[i].data.fd == WakeupFd) {
+                if (reason == PLATFORM_WAKE_TIMEOUT) reason = PLATFORM_WAKE_USER;
+            } else {
+                reason = PLATFORM_WAKE_INPUT;
+            }
+        }
+    }
+
+    platform_update();
+
+    return reason;
+}
+
+void platform_wakeup() {
+    u64 one = 1;
+    if (WakeupFd != -1) write(WakeupFd, &one, sizeof(one));
+}
+
+PlatformFileWatcher *platform_watch_file(String file, Allocator alloc) {
+    SCOPE_TEMP_STORAGE();
+
+    // NOTE: Editors often replace the file instead of writing into it, which would
+    //       remove a watch on the file itself. So the folder is watched instead.
+    s64 slash = find_last(file, '/');
+    String folder = ".";
+    if (slash == 0)     folder = "/";
+    else if (slash > 0) folder = head_until(file, slash);
+
+    String name = tail_from(file, slash + 1);
+
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd == -1) return 0;
+
+    // NOTE: Only finished writes and replacements count. A created file isn't written yet
+    //       and would be reloaded empty or half written.
+    CString c_folder = alloc_c_string(folder);
+    int watch = inotify_add_watch(fd, c_folder.data, IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (watch == -1) {
+        close(fd);
+        return 0;
+    }
+
+    add_wait_source(fd);
+
+    PlatformFileWatcher *watcher = ALLOC(alloc, PlatformFileWatcher, 1);
+    watcher->allocator = alloc;
+    watcher->fd    = fd;
+    watcher->watch = watch;
+    watcher->name  = allocate_string(name, alloc);
+
+    return watcher;
+}
+
+void platform_unwatch_file(PlatformFileWatcher *watcher) {
+    if (!watcher) return;
+
+    close(watcher->fd);
+
+    Allocator alloc = watcher->allocator;
+    destroy(&watcher->name, alloc);
+    DEALLOC(alloc, watcher, 1);
+}
+
+b32 platform_file_changed(PlatformFileWatcher *watcher) {
+    b32 changed = false;
+
+    alignas(inotify_event) u8 buffer[4096];
+    for (;;) {
+        ssize_t bytes_read = read(watcher->fd, buffer, sizeof(buffer));
+        if (bytes_read <= 0) break;
+
+        for (s64 pos = 0; pos < bytes_read;) {
+            inotify_event *event = (inotify_event*)(buffer + pos);
+            if (event->len) {
+                String name = {(u8*)event->name, c_string_length(event->name)};
+                if (name == watcher->name) changed = true;
+            }
+
+            pos += sizeof(inotify_event) + event->len;
+        }
+    }
+
+    return changed;
+}
+
 PlatformFile platform_file_open(String filename, PlatformFileOptions options) {
     SCOPE_TEMP_STORAGE();
 
@@ -222,7 +432,8 @@ PlatformFile platform_file_open(String filename, PlatformFileOptions options) {
 
     CString c_filename = alloc_c_string(filename);
 
-    int fd = open(c_filename.data, mode);
+    // NOTE: The permissions are only used when O_CREAT creates the file.
+    int fd = open(c_filename.data, mode, 0644);
     if (fd == -1) {
         return result;
     }
@@ -314,6 +525,36 @@ PlatformExecutionContext platform_execute(String command) {
     return context;
 }
 
+// NOTE: Timestamps are in nanoseconds of the monotonic clock.
+s64 platform_timestamp() {
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (s64)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+r64 platform_in_milliseconds(s64 timestamp) {
+    return (r64)timestamp / 1000000.0;
+}
+
+s64 platform_from_milliseconds(r64 milliseconds) {
+    return (s64)(milliseconds * 1000000.0);
+}
+
+void platform_sleep_until(s64 timestamp) {
+    s64 wake = timestamp - (s64)PLATFORM_SLEEP_SPIN_MICROSECONDS * 1000;
+
+    if (wake > platform_timestamp()) {
+        timespec time;
+        time.tv_sec  = wake / 1000000000;
+        time.tv_nsec = wake % 1000000000;
+
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &time, 0) == EINTR);
+    }
+
+    while (platform_timestamp() < timestamp);
+}
+
 INTERNAL PlatformFile StandardOutHandle;
 INTERNAL PlatformFile StandardInHandle;
 INTERNAL b32 setup_terminal() {
@@ -339,6 +580,7 @@ int main(int argc, char **argv) {
     TempAllocator = make_arena_allocator(&TempStorage);
 
     setup_terminal();
+    setup_wait();
 
     List<String> args = {};
     init(&args, argc);
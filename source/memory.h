@@ -49,13 +49,21 @@ void reset_temp_storage();
 
 #define INIT_STRUCT(ptr) zero_memory(ptr, sizeof(*ptr))
 inline void zero_memory(void *data, u64 bytes) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_memset(data, 0, bytes);
+#else
     u8 *tmp = (u8*)data;
     for (u64 i = 0; i < bytes; i += 1) {
         tmp[i] = 0;
     }
+#endif
 }
 
+// NOTE: Overlapping ranges are fine.
 inline void copy_memory(void *dest, void const *src, u64 size) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_memmove(dest, src, size);
+#else
     u8 *d = (u8*)dest;
     u8 *s = (u8*)src;
 
@@ -68,6 +76,7 @@ inline void copy_memory(void *dest, void const *src, u64 size) {
             d[i - 1] = s[i - 1];
         }
     }
+#endif
 }
 
 
@@ -27,9 +27,12 @@ b32 load_opengl_functions(PlatformOpenGLContext *context) {
     LOAD(glBufferSubData);
     LOAD(glVertexAttribPointer);
     LOAD(glEnableVertexAttribArray);
+    LOAD(glVertexAttribDivisor);
     LOAD(glUseProgram);
     LOAD(glUniformMatrix4fv);
     LOAD(glDrawArrays);
+    LOAD(glDrawArraysInstanced);
+    LOAD(glDrawElements);
     LOAD(glCreateShader);
     LOAD(glDeleteShader);
     LOAD(glShaderSource);
@@ -56,6 +56,7 @@ typedef s64 GLintptr;
 #define GL_FALSE            0
 #define GL_TRUE             1
 #define GL_UNSIGNED_BYTE    0x1401
+#define GL_SHORT            0x1402
 #define GL_UNSIGNED_SHORT   0x1403
 #define GL_UNSIGNED_INT     0x1405
 #define GL_INT              0x1404
@@ -208,11 +209,13 @@ OPENGL_FUNC(void,   glBufferData, GLenum, GLsizeiptr, void const*, GLenum);
 OPENGL_FUNC(void,   glBufferSubData, GLenum, GLintptr, GLsizeiptr, void const*);
 OPENGL_FUNC(void,   glVertexAttribPointer, GLuint, GLint, GLenum, GLboolean, GLsizei, void const*);
 OPENGL_FUNC(void,   glEnableVertexAttribArray, GLuint);
+OPENGL_FUNC(void,   glVertexAttribDivisor, GLuint, GLuint);
 OPENGL_FUNC(void,   glUseProgram, GLuint);
 OPENGL_FUNC(void,   glUniform2i, GLint, GLint, GLint);
 OPENGL_FUNC(void,   glUniformMatrix4fv, GLint, GLsizei, GLboolean, GLfloat const*);
 OPENGL_FUNC(void,   glDrawArrays, GLenum, GLint, GLsizei);
 OPENGL_FUNC(void,   glDrawElements, GLenum mode, GLsizei count, GLenum type, void const *indices);
+OPENGL_FUNC(void,   glDrawArraysInstanced, GLenum, GLint, GLsizei, GLsizei);
 
 OPENGL_FUNC(GLuint, glCreateShader, GLenum);
 OPENGL_FUNC(void,   glDeleteShader, GLuint);
@@ -61,7 +61,7 @@ b32  platform_delete_file(String path);
 void platform_delete_folder_content(String path);
 b32  platform_create_folder(String name);
 b32  platform_create_all_folders(String names);
-b32  platform_rename_file(String from, String to);
+b32  platform_rename_file(String from, String to); // NOTE: Replaces to if it exists.
 
 String platform_line_ending();
 
@@ -101,6 +101,31 @@ struct PlatformReadResult {
 };
 PlatformReadResult platform_read_entire_file(String file, Allocator alloc = DefaultAllocator);
 
+// NOTE: Read only view of the whole file without copying it. The content stays valid
+//       until the file is unmapped. Empty files don't get a mapping, only an empty content.
+//       Truncating the file on disk while it is mapped is not supported.
+struct PlatformMappedFile {
+    String content;
+    s32 error;
+
+    void *handle;
+};
+PlatformMappedFile platform_map_entire_file(String file);
+void               platform_unmap_file(PlatformMappedFile *file);
+
+
+//===============================================
+// Watches a single file for changes. Replacing the
+// file (like most editors do on save) counts as a
+// change, too. platform_file_changed never blocks
+// and reports if anything happened since the last
+// call.
+//===============================================
+struct PlatformFileWatcher;
+PlatformFileWatcher *platform_watch_file(String file, Allocator alloc = DefaultAllocator);
+void                 platform_unwatch_file(PlatformFileWatcher *watcher);
+b32                  platform_file_changed(PlatformFileWatcher *watcher);
+
 
 s64 platform_timestamp();
 r64 platform_in_milliseconds(s64 timestamp);
@@ -112,9 +137,69 @@ void                    platform_close_dynamic_library(PlatformDynamicLibrary *l
 void *platform_load_function(PlatformDynamicLibrary *lib);
 
 
-// TODO: Make it possible to specify if the update should wait for messages
-//       and/or signals.
+//===============================================
+// platform_update handles everything pending and
+// returns right away. Tools with nothing to do
+// until the user does something should call
+// platform_wait_for_update instead, which first
+// blocks until a window message arrives, another
+// thread calls platform_wakeup or timeout_ms has
+// passed. A negative timeout waits forever.
+//
+// On Linux terminal input and changes of watched
+// files wake it up as well. They only wake it once
+// per change, input that was not read doesn't keep
+// waking it.
+//===============================================
+enum PlatformWakeReason {
+    PLATFORM_WAKE_TIMEOUT,
+    PLATFORM_WAKE_INPUT,
+    PLATFORM_WAKE_USER,   // NOTE: platform_wakeup was called.
+    PLATFORM_WAKE_SIGNAL, // NOTE: Linux only, a signal handler interrupted the wait.
+};
+
 void platform_update();
+PlatformWakeReason platform_wait_for_update(s64 timeout_ms = -1);
+// NOTE: Safe to call from any thread.
+void platform_wakeup();
+
+
+//===============================================
+// The OS alone often oversleeps by a good part of
+// a frame. platform_sleep_until only sleeps until
+// PLATFORM_SLEEP_SPIN_MICROSECONDS before the
+// timestamp and spins the rest.
+//===============================================
+#ifndef PLATFORM_SLEEP_SPIN_MICROSECONDS
+#define PLATFORM_SLEEP_SPIN_MICROSECONDS 200
+#endif
+
+s64  platform_from_milliseconds(r64 milliseconds);
+void platform_sleep_until(s64 timestamp);
+
+struct PlatformFramePacer {
+    s64 frame_time; // NOTE: In timestamp units.
+    s64 next_frame;
+};
+
+inline void init(PlatformFramePacer *pacer, r64 frame_milliseconds) {
+    pacer->frame_time = platform_from_milliseconds(frame_milliseconds);
+    pacer->next_frame = 0;
+}
+
+// NOTE: Call once per frame, sleeps until the next frame is due. After a frame that was
+//       late by more than a whole frame the pacing starts over instead of rushing to catch up.
+inline void pace_frame(PlatformFramePacer *pacer) {
+    s64 now = platform_timestamp();
+
+    if (pacer->next_frame == 0 || now - pacer->next_frame > pacer->frame_time) {
+        pacer->next_frame = now;
+    } else {
+        platform_sleep_until(pacer->next_frame);
+    }
+
+    pacer->next_frame += pacer->frame_time;
+}
 
 struct PlatformWindow;
 PlatformWindow *platform_create_window();
@@ -0,0 +1,400 @@
+#include "schema.h"
+
+
+s64 const SchemaHeaderSize = 16;
+
+INTERNAL s64 kind_size(SchemaKind kind) {
+    switch (kind) {
+    case SCHEMA_U8:
+    case SCHEMA_S8:  return 1;
+    case SCHEMA_U16:
+    case SCHEMA_S16: return 2;
+    case SCHEMA_U32:
+    case SCHEMA_S32:
+    case SCHEMA_R32: return 4;
+    case SCHEMA_U64:
+    case SCHEMA_S64:
+    case SCHEMA_R64: return 8;
+
+    // NOTE: Everything else is stored as an offset.
+    default:         return 4;
+    }
+}
+
+INTERNAL r64 scalar_value(SchemaKind kind, u8 const *data) {
+    switch (kind) {
+    case SCHEMA_U8:  return *(u8  const*)data;
+    case SCHEMA_U16: return *(u16 const*)data;
+    case SCHEMA_U32: return *(u32 const*)data;
+    case SCHEMA_U64: return (r64)*(u64 const*)data;
+    case SCHEMA_S8:  return *(s8  const*)data;
+    case SCHEMA_S16: return *(s16 const*)data;
+    case SCHEMA_S32: return *(s32 const*)data;
+    case SCHEMA_S64: return (r64)*(s64 const*)data;
+    case SCHEMA_R32: return *(r32 const*)data;
+    case SCHEMA_R64: return *(r64 const*)data;
+
+    default: die("Not a scalar."); return 0;
+    }
+}
+
+INTERNAL void store_scalar(SchemaKind kind, u8 *data, r64 value) {
+    switch (kind) {
+    case SCHEMA_U8:  *(u8 *)data = (u8) value; break;
+    case SCHEMA_U16: *(u16*)data = (u16)value; break;
+    case SCHEMA_U32: *(u32*)data = (u32)value; break;
+    case SCHEMA_U64: *(u64*)data = (u64)value; break;
+    case SCHEMA_S8:  *(s8 *)data = (s8) value; break;
+    case SCHEMA_S16: *(s16*)data = (s16)value; break;
+    case SCHEMA_S32: *(s32*)data = (s32)value; break;
+    case SCHEMA_S64: *(s64*)data = (s64)value; break;
+    case SCHEMA_R32: *(r32*)data = (r32)value; break;
+    case SCHEMA_R64: *(r64*)data = value;      break;
+
+    default: die("Not a scalar.");
+    }
+}
+
+INTERNAL b32 is_scalar(SchemaKind kind) {
+    return kind > SCHEMA_NONE && kind < SCHEMA_STRING;
+}
+
+// NOTE: Scalars equal to their default are skipped like absent fields.
+INTERNAL b32 is_default(SchemaField const *field, u8 const *member) {
+    if (is_scalar(field->kind)) {
+        // NOTE: Compared bitwise for 64 bit integers, r64 can't hold all of them.
+        if (field->kind == SCHEMA_U64 || field->kind == SCHEMA_S64) {
+            u64 def = (field->kind == SCHEMA_U64) ? (u64)field->default_value : (u64)(s64)field->default_value;
+
+            return *(u64 const*)member == def;
+        }
+
+        return scalar_value(field->kind, member) == field->default_value;
+    }
+
+    switch (field->kind) {
+    case SCHEMA_STRING:      return ((String const*)member)->size == 0;
+    case SCHEMA_ARRAY:
+    case SCHEMA_TABLE_ARRAY: return ((Array<u8> const*)member)->size == 0;
+    default:                 return false;
+    }
+}
+
+
+void init(SchemaWriter *writer, u32 identifier, u32 version, Allocator alloc) {
+    INIT_STRUCT(writer);
+    writer->builder.allocator = alloc;
+
+    write_binary(&writer->builder, identifier);
+    write_binary(&writer->builder, version);
+    write_binary(&writer->builder, (u32)0); // NOTE: Root, patched by finish.
+    write_binary(&writer->builder, (u32)0); // NOTE: Size, patched by finish.
+}
+
+void destroy(SchemaWriter *writer) {
+    destroy(&writer->builder);
+}
+
+void finish(SchemaWriter *writer, u32 root) {
+    patch_binary(&writer->builder, 8,  root);
+    patch_binary(&writer->builder, 12, (u32)writer->builder.total_size);
+}
+
+INTERNAL u32 write_string(SchemaWriter *writer, String str) {
+    u32 offset = (u32)writer->builder.total_size;
+    write_binary_string(&writer->builder, str);
+
+    return offset;
+}
+
+INTERNAL u32 write_array(SchemaWriter *writer, SchemaKind element_kind, Array<u8> const *array) {
+    s64 element_size = kind_size(element_kind);
+
+    // NOTE: The count is followed by the elements, both naturally aligned.
+    align_binary(&writer->builder, 4);
+    if (element_size == 8 && writer->builder.total_size % 8 == 0) write_binary(&writer->builder, (u32)0);
+
+    u32 offset = (u32)writer->builder.total_size;
+    write_binary(&writer->builder, (u32)array->size);
+    append_raw(&writer->builder, array->data, array->size * element_size);
+
+    return offset;
+}
+
+INTERNAL u32 write_table_array(SchemaWriter *writer, Schema const *child, Array<u8> const *array) {
+    SCOPE_TEMP_STORAGE();
+
+    Array<u32> offsets = array_allocate<u32>(array->size, TempAllocator);
+    for (s64 i = 0; i < array->size; i += 1) {
+        offsets[i] = write_table(writer, child, array->data + i * child->size);
+    }
+
+    align_binary(&writer->builder, 4);
+
+    u32 offset = (u32)writer->builder.total_size;
+    write_binary(&writer->builder, (u32)offsets.size);
+    write_binary_array(&writer->builder, offsets.data, offsets.size);
+
+    return offset;
+}
+
+u32 write_table(SchemaWriter *writer, Schema const *schema, void const *object) {
+    u8 const *base = (u8 const*)object;
+
+    // NOTE: Out of line data first, the table needs the offsets.
+    u32 references[MaxSchemaFieldId + 1] = {};
+    s32 slot_count = 0;
+
+    for (s32 i = 0; i < schema->field_count; i += 1) {
+        SchemaField const *field = &schema->fields[i];
+        u8 const *member = base + field->offset;
+
+        assert(field->id <= MaxSchemaFieldId);
+        if (field->id >= slot_count) slot_count = field->id + 1;
+
+        if (is_default(field, member)) continue;
+
+        switch (field->kind) {
+        case SCHEMA_STRING:      references[field->id] = write_string(writer, *(String const*)member); break;
+        case SCHEMA_ARRAY:       references[field->id] = write_array(writer, field->element_kind, (Array<u8> const*)member); break;
+        case SCHEMA_TABLE:       references[field->id] = write_table(writer, field->child, member); break;
+        case SCHEMA_TABLE_ARRAY: references[field->id] = write_table_array(writer, field->child, (Array<u8> const*)member); break;
+        default: break;
+        }
+    }
+
+    // NOTE: Place the fields from the largest to the smallest, that keeps them aligned without padding.
+    u8  table[8 + (MaxSchemaFieldId + 1) * 8] = {};
+    u16 vtable[MaxSchemaFieldId + 3] = {};
+    s64 table_size = 4;
+
+    for (s64 size = 8; size >= 1; size /= 2) {
+        for (s32 i = 0; i < schema->field_count; i += 1) {
+            SchemaField const *field = &schema->fields[i];
+            u8 const *member = base + field->offset;
+
+            if (kind_size(field->kind) != size || is_default(field, member)) continue;
+
+            if (size == 8 && table_size % 8) table_size += 4;
+
+            if (is_scalar(field->kind)) copy_memory(table + table_size, member, size);
+            else                        copy_memory(table + table_size, &references[field->id], size);
+
+            vtable[2 + field->id] = (u16)table_size;
+            table_size += size;
+        }
+    }
+
+    vtable[0] = (u16)slot_count;
+    vtable[1] = (u16)table_size;
+
+    // NOTE: Reuse the vtable of the previous table if the layout is the same.
+    s32 vtable_size = 2 + slot_count;
+    u32 vtable_offset = writer->last_vtable_offset;
+
+    b32 same = vtable_offset && vtable_size == writer->last_vtable_size;
+    for (s32 i = 0; same && i < vtable_size; i += 1) {
+        same = vtable[i] == writer->last_vtable[i];
+    }
+
+    if (!same) {
+        align_binary(&writer->builder, 2);
+
+        vtable_offset = (u32)writer->builder.total_size;
+        write_binary_array(&writer->builder, vtable, vtable_size);
+
+        copy_memory(writer->last_vtable, vtable, vtable_size * sizeof(u16));
+        writer->last_vtable_size   = vtable_size;
+        writer->last_vtable_offset = vtable_offset;
+    }
+
+    align_binary(&writer->builder, 8);
+    copy_memory(table, &vtable_offset, sizeof(u32));
+
+    u32 offset = (u32)writer->builder.total_size;
+    append_raw(&writer->builder, table, table_size);
+
+    return offset;
+}
+
+
+INTERNAL b32 open_table(String buffer, u32 offset, SchemaTable *table) {
+    INIT_STRUCT(table);
+    table->buffer = buffer;
+
+    if (offset == 0) return true;
+    if (offset % 4 || offset < SchemaHeaderSize || buffer.size - 4 < offset) return false;
+
+    u32 vtable = read_le_u32(buffer, (s64)offset);
+    if (vtable % 2 || vtable < SchemaHeaderSize || buffer.size - 4 < vtable) return false;
+
+    u16 slot_count = read_le_u16(buffer, (s64)vtable);
+    u16 table_size = read_le_u16(buffer, (s64)vtable + 2);
+    if (buffer.size - 4 - 2 * slot_count < vtable || buffer.size - table_size < offset) return false;
+
+    table->offset     = offset;
+    table->vtable     = vtable;
+    table->slot_count = slot_count;
+    table->size       = table_size;
+
+    return true;
+}
+
+b32 open_schema_buffer(SchemaBuffer *buffer, String data, u32 identifier) {
+    INIT_STRUCT(buffer);
+
+    if (data.size < SchemaHeaderSize) return false;
+    if (read_le_u32(data, (s64)0)  != identifier) return false;
+    if (read_le_u32(data, (s64)12) != (u64)data.size) return false;
+
+    buffer->data       = data;
+    buffer->identifier = identifier;
+    buffer->version    = read_le_u32(data, (s64)4);
+
+    return open_table(data, read_le_u32(data, (s64)8), &buffer->root);
+}
+
+// NOTE: open_table checked that the table lies within the buffer, so a field inside the table does too.
+u32 field_offset(SchemaTable *table, u16 id, s64 size) {
+    if (id >= table->slot_count) return 0;
+
+    u16 relative = read_le_u16(table->buffer, (s64)table->vtable + 4 + 2 * id);
+    if (relative == 0) return 0;
+
+    if ((s64)relative + size > table->size) die("Field outside of its table.");
+
+    return table->offset + relative;
+}
+
+b32 has_field(SchemaTable *table, u16 id) {
+    return field_offset(table, id) != 0;
+}
+
+String table_string(SchemaTable *table, u16 id, String def) {
+    u32 offset = table_scalar<u32>(table, id);
+    if (offset == 0) return def;
+
+    String buffer = table->buffer;
+    if (buffer.size <= offset) die("String offset out of bounds.");
+
+    u64 length = 0;
+    s32 bytes  = decode_varint(buffer.data + offset, buffer.data + buffer.size, &length);
+    if (bytes == 0 || length > (u64)(buffer.size - offset - bytes)) die("String length out of bounds.");
+
+    String result = {buffer.data + offset + bytes, (s64)length};
+
+    return result;
+}
+
+SchemaTable table_child(SchemaTable *table, u16 id) {
+    SchemaTable child;
+    if (!open_table(table->buffer, table_scalar<u32>(table, id), &child)) die("Broken table offset.");
+
+    return child;
+}
+
+s64 table_count(SchemaTable *table, u16 id) {
+    u32 offset = table_scalar<u32>(table, id);
+    if (offset == 0) return 0;
+
+    if (table->buffer.size - 4 < offset) die("Array count out of bounds.");
+
+    return read_le_u32(table->buffer, (s64)offset);
+}
+
+SchemaTable table_at(SchemaTable *table, u16 id, s64 index) {
+    u32 offset = table_scalar<u32>(table, id);
+    BOUNDS_CHECK(0, table_count(table, id) - 1, index, "Array indexing out of bounds");
+
+    s64 element = (s64)offset + 4 + index * 4;
+    if (table->buffer.size - 4 < element) die("Table array element out of bounds.");
+
+    SchemaTable child;
+    if (!open_table(table->buffer, read_le_u32(table->buffer, element), &child)) die("Broken table offset.");
+
+    return child;
+}
+
+
+INTERNAL void read_array(SchemaTable *table, SchemaField const *field, Array<u8> *out, Allocator alloc) {
+    u32 offset = table_scalar<u32>(table, field->id);
+    if (offset == 0) {
+        *out = {};
+        return;
+    }
+
+    s64 element_size = kind_size(field->element_kind);
+    if (table->buffer.size - 4 < offset) die("Array count out of bounds.");
+
+    s64 count = read_le_u32(table->buffer, (s64)offset);
+    if ((table->buffer.size - offset - 4) / element_size < count) die("Array elements out of bounds.");
+
+    u8 *data = table->buffer.data + offset + 4;
+
+#ifdef BINARY_LITTLE_ENDIAN
+    (void)alloc;
+    out->data = data;
+#else
+    out->data = (u8*)allocate(alloc, count * element_size);
+    for (s64 i = 0; i < count; i += 1) {
+        for (s64 b = 0; b < element_size; b += 1) {
+            out->data[i * element_size + b] = data[i * element_size + element_size - 1 - b];
+        }
+    }
+#endif
+    out->size = count;
+}
+
+void read_table(SchemaTable *table, Schema const *schema, void *object, Allocator alloc) {
+    u8 *base = (u8*)object;
+
+    for (s32 i = 0; i < schema->field_count; i += 1) {
+        SchemaField const *field = &schema->fields[i];
+        u8 *member = base + field->offset;
+
+        if (is_scalar(field->kind)) {
+            u32 offset = field_offset(table, field->id, kind_size(field->kind));
+            if (offset) {
+                u8 *data = table->buffer.data + offset;
+                switch (kind_size(field->kind)) {
+                case 1: *member = *data; break;
+                case 2: { u16 v = load_le<u16>(data); copy_memory(member, &v, 2); } break;
+                case 4: { u32 v = load_le<u32>(data); copy_memory(member, &v, 4); } break;
+                case 8: { u64 v = load_le<u64>(data); copy_memory(member, &v, 8); } break;
+                }
+            } else {
+                store_scalar(field->kind, member, field->default_value);
+            }
+
+            continue;
+        }
+
+        switch (field->kind) {
+        case SCHEMA_STRING: {
+            *(String*)member = table_string(table, field->id);
+        } break;
+
+        case SCHEMA_ARRAY: {
+            read_array(table, field, (Array<u8>*)member, alloc);
+        } break;
+
+        case SCHEMA_TABLE: {
+            SchemaTable child = table_child(table, field->id);
+            read_table(&child, field->child, member, alloc);
+        } break;
+
+        case SCHEMA_TABLE_ARRAY: {
+            Array<u8> *array = (Array<u8>*)member;
+            array->size = table_count(table, field->id);
+            array->data = array->size ? (u8*)allocate(alloc, array->size * field->child->size) : 0;
+
+            for (s64 e = 0; e < array->size; e += 1) {
+                SchemaTable child = table_at(table, field->id, e);
+                read_table(&child, field->child, array->data + e * field->child->size, alloc);
+            }
+        } break;
+
+        default: break;
+        }
+    }
+}
@@ -0,0 +1,253 @@
+//================================================
+// Schema driven binary serialization. A struct is
+// described once by a list of fields, each with a
+// stable id, and written as a table:
+//
+//   table  u32 vtable offset, then the present fields
+//   vtable u16 slot count, u16 table size,
+//          u16 offset into the table per field id
+//          (0 means absent, the reader uses the default)
+//
+// Strings, arrays and child tables are stored out of
+// line and referenced by u32 offsets from the start
+// of the buffer. Everything is little endian and
+// aligned, so a loaded or mapped buffer is read in
+// place without a decode pass.
+//
+// Versioning: give new fields new ids and never
+// reuse old ones. Old buffers simply miss the new
+// fields and readers get their defaults, old readers
+// ignore ids they don't know about.
+//
+// Example:
+//
+//   struct Glyph { u32 cp; r32 advance; String name; };
+//
+//   SchemaField const GlyphFields[] = {
+//       SCHEMA_FIELD(Glyph, cp, 0),
+//       SCHEMA_FIELD_DEFAULT(Glyph, advance, 1, 1.0),
+//       SCHEMA_FIELD(Glyph, name, 2),
+//   };
+//   Schema const GlyphSchema = MAKE_SCHEMA(Glyph, GlyphFields);
+//================================================
+#pragma once
+
+#include "definitions.h"
+#include "binary.h"
+
+
+enum SchemaKind : u8 {
+    SCHEMA_NONE,
+
+    SCHEMA_U8,
+    SCHEMA_U16,
+    SCHEMA_U32,
+    SCHEMA_U64,
+    SCHEMA_S8,
+    SCHEMA_S16,
+    SCHEMA_S32,
+    SCHEMA_S64,
+    SCHEMA_R32,
+    SCHEMA_R64,
+
+    SCHEMA_STRING,
+    SCHEMA_ARRAY,       // NOTE: Array<Type> of a scalar type.
+    SCHEMA_TABLE,       // NOTE: An embedded struct with its own schema.
+    SCHEMA_TABLE_ARRAY, // NOTE: Array<Type> of structs with their own schema.
+};
+
+struct Schema;
+
+struct SchemaField {
+    u16 id;
+    SchemaKind kind;
+    SchemaKind element_kind;
+
+    u32 offset;  // NOTE: Of the member inside the struct.
+    r64 default_value; // NOTE: Scalars only, 64 bit integers above 2^53 can't be a default.
+
+    Schema const *child;
+};
+
+struct Schema {
+    u32 size;
+
+    SchemaField const *fields;
+    s32 field_count;
+};
+
+s32 const MaxSchemaFieldId = 255;
+
+
+template<class Type> struct SchemaKindOf { static SchemaKind const kind = SCHEMA_NONE; };
+template<> struct SchemaKindOf<u8>     { static SchemaKind const kind = SCHEMA_U8;     };
+template<> struct SchemaKindOf<u16>    { static SchemaKind const kind = SCHEMA_U16;    };
+template<> struct SchemaKindOf<u32>    { static SchemaKind const kind = SCHEMA_U32;    };
+template<> struct SchemaKindOf<u64>    { static SchemaKind const kind = SCHEMA_U64;    };
+template<> struct SchemaKindOf<s8>     { static SchemaKind const kind = SCHEMA_S8;     };
+template<> struct SchemaKindOf<s16>    { static SchemaKind const kind = SCHEMA_S16;    };
+template<> struct SchemaKindOf<s32>    { static SchemaKind const kind = SCHEMA_S32;    };
+template<> struct SchemaKindOf<s64>    { static SchemaKind const kind = SCHEMA_S64;    };
+template<> struct SchemaKindOf<r32>    { static SchemaKind const kind = SCHEMA_R32;    };
+template<> struct SchemaKindOf<r64>    { static SchemaKind const kind = SCHEMA_R64;    };
+template<> struct SchemaKindOf<String> { static SchemaKind const kind = SCHEMA_STRING; };
+
+template<class Type>
+struct SchemaKindOf<Array<Type>> {
+    static SchemaKind const kind = SCHEMA_ARRAY;
+    static SchemaKind const element_kind = SchemaKindOf<Type>::kind;
+};
+
+template<class Type>
+SchemaField schema_field(u16 id, u64 offset, r64 default_value, Type*) {
+    static_assert(SchemaKindOf<Type>::kind != SCHEMA_NONE, "Type can't be serialized, use SCHEMA_TABLE for structs.");
+
+    SchemaField field = {};
+    field.id            = id;
+    field.kind          = SchemaKindOf<Type>::kind;
+    field.offset        = (u32)offset;
+    field.default_value = default_value;
+
+    return field;
+}
+
+template<class Type>
+SchemaField schema_field(u16 id, u64 offset, r64 default_value, Array<Type>*) {
+    static_assert(SchemaKindOf<Type>::kind != SCHEMA_NONE && SchemaKindOf<Type>::kind < SCHEMA_STRING, "Only arrays of scalars, use SCHEMA_TABLE for arrays of structs.");
+
+    SchemaField field = {};
+    field.id           = id;
+    field.kind         = SCHEMA_ARRAY;
+    field.element_kind = SchemaKindOf<Type>::kind;
+    field.offset       = (u32)offset;
+
+    return field;
+}
+
+template<class Type>
+SchemaField schema_table_field(u16 id, u64 offset, Schema const *child, Type*) {
+    SchemaField field = {};
+    field.id     = id;
+    field.kind   = SCHEMA_TABLE;
+    field.offset = (u32)offset;
+    field.child  = child;
+
+    return field;
+}
+
+template<class Type>
+SchemaField schema_table_field(u16 id, u64 offset, Schema const *child, Array<Type>*) {
+    SchemaField field = {};
+    field.id     = id;
+    field.kind   = SCHEMA_TABLE_ARRAY;
+    field.offset = (u32)offset;
+    field.child  = child;
+
+    return field;
+}
+
+#define SCHEMA_MEMBER_TAG(type, member) ((decltype(((type*)0)->member)*)0)
+
+#define SCHEMA_FIELD(type, member, id)              schema_field(id, STRUCT_OFFSET(type, member), 0.0, SCHEMA_MEMBER_TAG(type, member))
+#define SCHEMA_FIELD_DEFAULT(type, member, id, def) schema_field(id, STRUCT_OFFSET(type, member), def, SCHEMA_MEMBER_TAG(type, member))
+#define SCHEMA_TABLE(type, member, id, child)       schema_table_field(id, STRUCT_OFFSET(type, member), child, SCHEMA_MEMBER_TAG(type, member))
+
+#define MAKE_SCHEMA(type, fields) {(u32)sizeof(type), fields, (s32)C_ARRAY_SIZE(fields)}
+
+
+//================================================
+// Writing. Children are written before the tables
+// that reference them, the root offset is patched
+// into the header by finish.
+//================================================
+struct SchemaWriter {
+    StringBuilder builder;
+
+    // NOTE: Tables of the same schema are usually written in a row, they share one vtable.
+    u16 last_vtable[MaxSchemaFieldId + 3];
+    s32 last_vtable_size;
+    u32 last_vtable_offset;
+};
+
+void init(SchemaWriter *writer, u32 identifier, u32 version, Allocator alloc = DefaultAllocator);
+void destroy(SchemaWriter *writer);
+
+u32  write_table(SchemaWriter *writer, Schema const *schema, void const *object);
+void finish(SchemaWriter *writer, u32 root);
+
+
+//================================================
+// Reading. Nothing is copied, strings and arrays
+// point into the buffer which has to outlive them.
+//================================================
+struct SchemaTable {
+    String buffer;
+
+    u32 offset;  // NOTE: 0 for an absent table, every field has its default then.
+    u32 vtable;
+    u16 slot_count;
+    u16 size;    // NOTE: In bytes, open_table checked that it lies within the buffer.
+};
+
+struct SchemaBuffer {
+    String data;
+
+    u32 identifier;
+    u32 version;
+
+    SchemaTable root;
+};
+
+// NOTE: Checks the header and the root table, returns false if the buffer is broken or of the wrong type.
+b32 open_schema_buffer(SchemaBuffer *buffer, String data, u32 identifier);
+
+// NOTE: Returns 0 if the field is absent. Dies if size bytes at the field don't fit into the table.
+u32  field_offset(SchemaTable *table, u16 id, s64 size = 1);
+b32  has_field(SchemaTable *table, u16 id);
+
+String      table_string(SchemaTable *table, u16 id, String def = {});
+SchemaTable table_child (SchemaTable *table, u16 id);
+s64         table_count (SchemaTable *table, u16 id);
+SchemaTable table_at    (SchemaTable *table, u16 id, s64 index);
+
+template<class Type>
+Type table_scalar(SchemaTable *table, u16 id, Type def = {}) {
+    u32 offset = field_offset(table, id, sizeof(Type));
+    if (offset == 0) return def;
+
+    return load_le<Type>(table->buffer.data + offset);
+}
+
+template<class Type>
+struct SchemaArray {
+    u8 *data;
+    s64 size;
+
+    Type operator[](s64 index) {
+        BOUNDS_CHECK(0, size - 1, index, "Array indexing out of bounds");
+
+        return load_le<Type>(data + index * sizeof(Type));
+    }
+};
+
+template<class Type>
+SchemaArray<Type> table_array(SchemaTable *table, u16 id) {
+    SchemaArray<Type> result = {};
+
+    u32 offset = table_scalar<u32>(table, id);
+    if (offset == 0) return result;
+
+    if (table->buffer.size - 4 < offset) die("Array count out of bounds.");
+
+    s64 count = read_le_u32(table->buffer, (s64)offset);
+    if ((table->buffer.size - offset - 4) / (s64)sizeof(Type) < count) die("Array elements out of bounds.");
+
+    result.data = table->buffer.data + offset + 4;
+    result.size = count;
+
+    return result;
+}
+
+// NOTE: Fills object from the table. Strings and scalar arrays point into the buffer,
+//       arrays of tables are allocated with alloc.
+void read_table(SchemaTable *table, Schema const *schema, void *object, Allocator alloc = DefaultAllocator);
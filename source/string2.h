@@ -3,24 +3,126 @@
 #include "memory.h"
 
 
+//===============================================
+// The search and compare functions work on 16 byte
+// blocks if SSE2 is available, which is always the
+// case on x64. Everything else falls back to the
+// plain byte loops.
+//===============================================
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define STRING_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+
+inline s32 lowest_set_bit(u32 mask) {
+    assert(mask);
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+
+    return (s32)index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+inline s32 highest_set_bit(u32 mask) {
+    assert(mask);
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse(&index, mask);
+
+    return (s32)index;
+#else
+    return 31 - __builtin_clz(mask);
+#endif
+}
+
+
 inline b32 is_any(u8 c, String delimiters) {
     for (s64 i = 0; i < delimiters.size; i += 1) {
-        if (c == delimiters[i]) return true;
+        if (c == delimiters.data[i]) return true;
     }
 
     return false;
 }
 
+//===============================================
+// A ByteSet is a 256 bit lookup table for delimiter
+// checks. Build it once (it can be constexpr for
+// literals) instead of looping over the delimiters
+// for every character.
+//===============================================
+struct ByteSet {
+    u32 bits[8];
+};
+
+inline constexpr ByteSet make_byte_set(char const *bytes) {
+    ByteSet set = {};
+    for (s64 i = 0; bytes[i]; i += 1) {
+        u8 c = (u8)bytes[i];
+        set.bits[c >> 5] |= 1u << (c & 31);
+    }
+
+    return set;
+}
+
+inline ByteSet make_byte_set(String bytes) {
+    ByteSet set = {};
+    for (s64 i = 0; i < bytes.size; i += 1) {
+        u8 c = bytes.data[i];
+        set.bits[c >> 5] |= 1u << (c & 31);
+    }
+
+    return set;
+}
+
+inline b32 is_any(u8 c, ByteSet const *set) {
+    return (set->bits[c >> 5] >> (c & 31)) & 1;
+}
+
+inline s64 find_first_of(String str, ByteSet const *set) {
+    for (s64 i = 0; i < str.size; i += 1) {
+        if (is_any(str.data[i], set)) return i;
+    }
+
+    return -1;
+}
+
+inline s64 find_first_not_of(String str, ByteSet const *set) {
+    for (s64 i = 0; i < str.size; i += 1) {
+        if (!is_any(str.data[i], set)) return i;
+    }
+
+    return -1;
+}
+
+ByteSet const LineBreakSet = make_byte_set("\n\r");
+
+
 inline b32 equal(String lhs, String rhs) {
-    if (lhs.size == rhs.size) {
-        for (s64 i = 0; i < lhs.size; i += 1) {
-            if (lhs[i] != rhs[i]) return false;
-        }
+    if (lhs.size != rhs.size) return false;
+    if (lhs.data == rhs.data) return true;
 
-        return true;
+    s64 i = 0;
+#ifdef STRING_USE_SSE2
+    for (; i + 16 <= lhs.size; i += 16) {
+        __m128i l = _mm_loadu_si128((__m128i const*)(lhs.data + i));
+        __m128i r = _mm_loadu_si128((__m128i const*)(rhs.data + i));
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(l, r)) != 0xFFFF) return false;
+    }
+#endif
+    for (; i < lhs.size; i += 1) {
+        if (lhs.data[i] != rhs.data[i]) return false;
     }
 
-    return false;
+    return true;
 }
 
 inline u8 lower_char(u8 c) {
@@ -31,16 +133,33 @@ inline u8 lower_char(u8 c) {
     return c;
 }
 
+#ifdef STRING_USE_SSE2
+inline __m128i lower_chars(__m128i chars) {
+    // NOTE: Moves 'A' to -128 so the range check becomes a single signed compare.
+    __m128i shifted  = _mm_add_epi8(chars, _mm_set1_epi8((char)(128 - 'A')));
+    __m128i is_upper = _mm_cmplt_epi8(shifted, _mm_set1_epi8((char)(-128 + 26)));
+
+    return _mm_or_si128(chars, _mm_and_si128(is_upper, _mm_set1_epi8(32)));
+}
+#endif
+
 inline b32 caseless_equal(String lhs, String rhs) {
-    if (lhs.size == rhs.size) {
-        for (s64 i = 0; i < lhs.size; i += 1) {
-           if (lower_char(lhs[i]) != lower_char(rhs[i])) return false;
-        }
+    if (lhs.size != rhs.size) return false;
+
+    s64 i = 0;
+#ifdef STRING_USE_SSE2
+    for (; i + 16 <= lhs.size; i += 16) {
+        __m128i l = lower_chars(_mm_loadu_si128((__m128i const*)(lhs.data + i)));
+        __m128i r = lower_chars(_mm_loadu_si128((__m128i const*)(rhs.data + i)));
 
-        return true;
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(l, r)) != 0xFFFF) return false;
+    }
+#endif
+    for (; i < lhs.size; i += 1) {
+       if (lower_char(lhs.data[i]) != lower_char(rhs.data[i])) return false;
     }
 
-    return false;
+    return true;
 }
 
 inline bool operator==(String lhs, String rhs) {
@@ -51,16 +170,6 @@ inline bool operator!=(String lhs, String rhs) {
     return !(equal(lhs, rhs));
 }
 
-inline b32 contains(String str, String search) {
-    for (s64 i = 0; i < str.size; i += 1) {
-        if (i + search.size > str.size) return false;
-
-        String tmp = {str.data + i, search.size};
-        if (equal(tmp, search)) return true;
-    }
-
-    return false;
-}
 
 inline b32 starts_with(String str, String begin) {
     if (str.size < begin.size) return false;
@@ -78,54 +187,151 @@ inline b32 ends_with(String str, String search) {
     return str == search;
 }
 
-inline String next_line(String str, s64 *offset) {
-    String result = {};
-
-    s64 pos = *offset;
-    result.data = &str[pos];
-
-    while (pos < str.size) {
-        if (is_any(str[pos], "\n\r")) {
-            result.size = pos - *offset;
-            break;
-        }
-
-        pos += 1;
+inline s64 find_first(String str, u8 c) {
+    s64 i = 0;
+#ifdef STRING_USE_SSE2
+    __m128i needle = _mm_set1_epi8((char)c);
+    for (; i + 16 <= str.size; i += 16) {
+        __m128i block = _mm_loadu_si128((__m128i const*)(str.data + i));
+
+        u32 mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+        if (mask) return i + lowest_set_bit(mask);
     }
-    while (pos < str.size) {
-        if (!is_any(str[pos], "\n\r")) break;
-
-        pos += 1;
+#endif
+    for (; i < str.size; i += 1) {
+        if (str.data[i] == c) return i;
     }
 
-    *offset = pos;
-
-    return result;
+    return -1;
 }
 
-inline s64 find_first(String str, u8 c) {
-    for (s64 i = 0; i < str.size; i += 1) {
-        if (str[i] == c) return i;
+inline s64 find_first_of(String str, u8 a, u8 b) {
+    s64 i = 0;
+#ifdef STRING_USE_SSE2
+    __m128i needle_a = _mm_set1_epi8((char)a);
+    __m128i needle_b = _mm_set1_epi8((char)b);
+    for (; i + 16 <= str.size; i += 16) {
+        __m128i block = _mm_loadu_si128((__m128i const*)(str.data + i));
+
+        __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(block, needle_a), _mm_cmpeq_epi8(block, needle_b));
+        u32 mask = _mm_movemask_epi8(hits);
+        if (mask) return i + lowest_set_bit(mask);
+    }
+#endif
+    for (; i < str.size; i += 1) {
+        if (str.data[i] == a || str.data[i] == b) return i;
     }
 
     return -1;
 }
 
 inline s64 find_last(String str, u8 c) {
-    for (s64 i = str.size; i > 0; i -= 1) {
+    s64 i = str.size;
+#ifdef STRING_USE_SSE2
+    __m128i needle = _mm_set1_epi8((char)c);
+    for (; i >= 16; i -= 16) {
+        __m128i block = _mm_loadu_si128((__m128i const*)(str.data + i - 16));
+
+        u32 mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+        if (mask) return i - 16 + highest_set_bit(mask);
+    }
+#endif
+    for (; i > 0; i -= 1) {
         s64 index = i - 1;
-        if (str[index] == c) return index;
+        if (str.data[index] == c) return index;
     }
 
     return -1;
 }
 
-inline String to_lower_case(String str) {
-    for (s64 i = 0; i < str.size; i += 1) {
-        if (str[i] >= 'A' && str[i] <= 'Z') {
-            str[i] |= 32;
+//===============================================
+// Substring search. Candidates are filtered by
+// checking the first and the last byte of search
+// for 16 positions at once and only the survivors
+// are compared completely.
+//===============================================
+inline s64 find_first(String str, String search) {
+    if (search.size == 0) return 0;
+    if (search.size > str.size) return -1;
+    if (search.size == 1) return find_first(str, search.data[0]);
+
+    s64 last_start = str.size - search.size;
+    s64 tail = search.size - 1;
+
+    u8 first_char = search.data[0];
+    u8 last_char  = search.data[tail];
+    String middle = {search.data + 1, search.size - 2};
+
+    s64 i = 0;
+#ifdef STRING_USE_SSE2
+    __m128i first_needle = _mm_set1_epi8((char)first_char);
+    __m128i last_needle  = _mm_set1_epi8((char)last_char);
+
+    // NOTE: The second load reads up to i + tail + 16 which is at most str.size.
+    for (; i + 16 <= last_start + 1; i += 16) {
+        __m128i first_block = _mm_loadu_si128((__m128i const*)(str.data + i));
+        __m128i last_block  = _mm_loadu_si128((__m128i const*)(str.data + i + tail));
+
+        __m128i candidates = _mm_and_si128(_mm_cmpeq_epi8(first_block, first_needle), _mm_cmpeq_epi8(last_block, last_needle));
+        u32 mask = _mm_movemask_epi8(candidates);
+        while (mask) {
+            s64 pos = i + lowest_set_bit(mask);
+            if (equal({str.data + pos + 1, middle.size}, middle)) return pos;
+
+            mask &= mask - 1;
         }
     }
+#endif
+    for (; i <= last_start; i += 1) {
+        if (str.data[i] != first_char || str.data[i + tail] != last_char) continue;
+        if (equal({str.data + i + 1, middle.size}, middle)) return i;
+    }
+
+    return -1;
+}
+
+inline b32 contains(String str, String search) {
+    return find_first(str, search) != -1;
+}
+
+inline String next_line(String str, s64 *offset) {
+    String result = {};
+
+    s64 pos = *offset;
+    result.data = &str[pos];
+
+    String rest = {str.data + pos, str.size - pos};
+    s64 line_end = find_first_of(rest, &LineBreakSet);
+    if (line_end == -1) {
+        result.size = rest.size;
+        *offset = str.size;
+
+        return result;
+    }
+    result.size = line_end;
+
+    String breaks = {rest.data + line_end, rest.size - line_end};
+    s64 next_start = find_first_not_of(breaks, &LineBreakSet);
+    if (next_start == -1) {
+        *offset = str.size;
+    } else {
+        *offset = pos + line_end + next_start;
+    }
+
+    return result;
+}
+
+inline String to_lower_case(String str) {
+    s64 i = 0;
+#ifdef STRING_USE_SSE2
+    for (; i + 16 <= str.size; i += 16) {
+        __m128i block = _mm_loadu_si128((__m128i const*)(str.data + i));
+        _mm_storeu_si128((__m128i*)(str.data + i), lower_chars(block));
+    }
+#endif
+    for (; i < str.size; i += 1) {
+        str.data[i] = lower_char(str.data[i]);
+    }
 
     return str;
 }
@@ -4,27 +4,70 @@
 #include "string2.h"
 
 
+// NOTE: The first block lives inside the builder itself, small outputs never allocate.
 #ifndef STRING_BUILDER_BLOCK_SIZE
 #define STRING_BUILDER_BLOCK_SIZE KILOBYTES(4)
 #endif
 
+#ifndef STRING_BUILDER_MAX_BLOCK_SIZE
+#define STRING_BUILDER_MAX_BLOCK_SIZE MEGABYTES(1)
+#endif
+
+//===============================================
+// Every allocated block doubles in size until the
+// builders max_block_size is reached, so building
+// big outputs needs few blocks. Set block_size and
+// max_block_size to the same value for a fixed
+// block size. A zero initialised builder uses the
+// defaults above.
+//
+// Blocks are kept on reset and reused by the next
+// appends. The builder must not be copied once
+// something was appended, the first block points
+// into it.
+//===============================================
 struct StringBuilder {
     Allocator allocator;
 
     struct StringBuilderBlock {
         StringBuilderBlock *next;
 
-        u8 buffer[STRING_BUILDER_BLOCK_SIZE];
+        u8 *buffer;
         s64 used;
+        s64 capacity;
     };
 
     StringBuilderBlock  first;
     StringBuilderBlock *current;
 
     s64 total_size;
+
+    s64 block_size; // NOTE: Size of the next allocated block.
+    s64 max_block_size;
+
+    u8 inline_buffer[STRING_BUILDER_BLOCK_SIZE];
 };
 
 
+inline void init(StringBuilder *builder, Allocator alloc = DefaultAllocator, s64 block_size = STRING_BUILDER_BLOCK_SIZE, s64 max_block_size = STRING_BUILDER_MAX_BLOCK_SIZE) {
+    INIT_STRUCT(&builder->first);
+    builder->allocator      = alloc;
+    builder->current        = 0;
+    builder->total_size     = 0;
+    builder->block_size     = block_size;
+    builder->max_block_size = max_block_size < block_size ? block_size : max_block_size;
+}
+
+inline StringBuilder::StringBuilderBlock *current_block(StringBuilder *builder) {
+    if (builder->current == 0) {
+        builder->first.buffer   = builder->inline_buffer;
+        builder->first.capacity = STRING_BUILDER_BLOCK_SIZE;
+        builder->current = &builder->first;
+    }
+
+    return builder->current;
+}
+
 inline void reset(StringBuilder *builder) {
     auto *block = &builder->first;
 
@@ -33,55 +76,95 @@ inline void reset(StringBuilder *builder) {
         block = block->next;
     }
 
+    builder->current    = 0;
     builder->total_size = 0;
 }
 
-inline void append(StringBuilder *builder, u8 c) {
-    if (builder->current == 0) builder->current = &builder->first;
-
-    if (builder->current->used + 1 > STRING_BUILDER_BLOCK_SIZE) {
-        if (builder->current->next == 0) {
-            builder->current->next = ALLOC(builder->allocator, StringBuilder::StringBuilderBlock, 1);
-        } else {
-            // NOTE: buffer not initialized to zero for speed
-            builder->current->next->used = 0;
-        }
-        builder->current = builder->current->next;
+// NOTE: Moves to a block with at least min_free bytes, reusing the blocks kept by reset if they are big enough.
+inline StringBuilder::StringBuilderBlock *add_block(StringBuilder *builder, s64 min_free) {
+    auto *current = current_block(builder);
+
+    auto *next = current->next;
+    if (next && next->capacity >= min_free) {
+        next->used = 0;
+        builder->current = next;
+
+        return next;
     }
 
-    builder->current->buffer[builder->current->used] = c;
-    builder->current->used += 1;
-    builder->total_size    += 1;
+    if (builder->block_size == 0)     builder->block_size     = STRING_BUILDER_BLOCK_SIZE;
+    if (builder->max_block_size == 0) builder->max_block_size = STRING_BUILDER_MAX_BLOCK_SIZE;
+
+    s64 capacity = builder->block_size;
+    if (capacity < min_free) capacity = min_free;
+
+    builder->block_size *= 2;
+    if (builder->block_size > builder->max_block_size) builder->block_size = builder->max_block_size;
+
+    // NOTE: The buffer directly follows the block header.
+    auto *block = (StringBuilder::StringBuilderBlock*)allocate(builder->allocator, sizeof(StringBuilder::StringBuilderBlock) + capacity);
+    block->buffer   = (u8*)(block + 1);
+    block->capacity = capacity;
+    block->used     = 0;
+    block->next     = next;
+
+    current->next    = block;
+    builder->current = block;
+
+    return block;
 }
 
-inline void append(StringBuilder *builder, String str) {
-    if (builder->current == 0) builder->current = &builder->first;
-
-    s64 space = STRING_BUILDER_BLOCK_SIZE - builder->current->used;
-    while (space < str.size) {
-        copy_memory(builder->current->buffer + builder->current->used, str.data, space);
-        builder->current->used += space;
-        builder->total_size    += space;
-        str = shrink_front(str, space);
-
-        if (builder->current->next == 0) {
-            builder->current->next = ALLOC(builder->allocator, StringBuilder::StringBuilderBlock, 1);
-        } else {
-            builder->current->next->used = 0;
-        }
-        builder->current = builder->current->next;
+// NOTE: Makes sure the next size bytes are appended into one block without allocating.
+//       Returns the position they will be written to, it is fine to write there directly
+//       and commit the bytes with advance afterwards.
+inline u8 *reserve(StringBuilder *builder, s64 size) {
+    auto *block = current_block(builder);
+    if (block->capacity - block->used < size) block = add_block(builder, size);
+
+    return block->buffer + block->used;
+}
+
+inline void advance(StringBuilder *builder, s64 size) {
+    auto *block = current_block(builder);
+    assert(block->used + size <= block->capacity);
+
+    block->used         += size;
+    builder->total_size += size;
+}
 
-        space = STRING_BUILDER_BLOCK_SIZE;
+inline void append(StringBuilder *builder, u8 c) {
+    auto *block = current_block(builder);
+    if (block->used == block->capacity) block = add_block(builder, 1);
+
+    block->buffer[block->used] = c;
+    block->used         += 1;
+    builder->total_size += 1;
+}
+
+inline void append_raw(StringBuilder *builder, void const *buffer, s64 size) {
+    u8 const *data = (u8 const*)buffer;
+    auto *block = current_block(builder);
+
+    s64 space = block->capacity - block->used;
+    if (space < size) {
+        // NOTE: Fill up the current block, the rest goes into one block big enough for all of it.
+        copy_memory(block->buffer + block->used, data, space);
+        block->used         += space;
+        builder->total_size += space;
+
+        data += space;
+        size -= space;
+
+        block = add_block(builder, size);
     }
 
-    copy_memory(builder->current->buffer + builder->current->used, str.data, str.size);
-    builder->current->used += str.size;
-    builder->total_size    += str.size;
+    copy_memory(block->buffer + block->used, data, size);
+    block->used         += size;
+    builder->total_size += size;
 }
 
-inline void append_raw(StringBuilder *builder, void *buffer, s64 size) {
-    String str = {(u8*)buffer, size};
-    append(builder, str);
+inline void append(StringBuilder *builder, String str) {
+    append_raw(builder, str.data, str.size);
 }
 
 inline void destroy(StringBuilder *builder) {
@@ -89,31 +172,98 @@ inline void destroy(StringBuilder *builder) {
 
     while (next) {
         auto *tmp = next->next;
-        DEALLOC(builder->allocator, next, 1);
+        deallocate(builder->allocator, next, sizeof(StringBuilder::StringBuilderBlock) + next->capacity);
 
         next = tmp;
     }
+
+    builder->first.next = 0;
+    builder->first.used = 0;
+    builder->current    = 0;
+    builder->total_size = 0;
+}
+
+inline void copy_content(StringBuilder *builder, u8 *dest) {
+    for (auto *block = &builder->first; block; block = block->next) {
+        copy_memory(dest, block->buffer, block->used);
+        dest += block->used;
+    }
 }
 
 inline String to_allocated_string(StringBuilder *builder, Allocator alloc = DefaultAllocator) {
     String result = allocate_string(builder->total_size, alloc);
+    copy_content(builder, result.data);
 
-    s64 size = 0;
-    auto *block = &builder->first;
-    while (block) {
-        copy_memory(result.data + size, block->buffer, block->used);
-        size += block->used;
+    return result;
+}
 
-        block = block->next;
+// NOTE: The block holding all of the content or 0 if it is spread over multiple blocks.
+inline StringBuilder::StringBuilderBlock *single_block(StringBuilder *builder) {
+    StringBuilder::StringBuilderBlock *result = 0;
+
+    for (auto *block = &builder->first; block; block = block->next) {
+        if (block->used == 0) continue;
+        if (result) return 0;
+
+        result = block;
     }
 
     return result;
 }
 
-inline String temp_string(StringBuilder *builder) {
-    assert(builder->total_size < STRING_BUILDER_BLOCK_SIZE);
+//===============================================
+// Returns the content without copying if it is in
+// one block. Otherwise it is flattened into a single
+// block once, following calls don't copy again.
+// The flat block is one of the unused blocks kept by
+// reset if one is big enough, otherwise it is newly
+// allocated. The blocks the content was in stay
+// linked behind it and are reused by the next
+// appends. The view is valid until the next append
+// or reset.
+//===============================================
+inline String to_string_view(StringBuilder *builder) {
+    if (builder->total_size == 0) return {};
+
+    auto *block = single_block(builder);
+    if (block) return {block->buffer, block->used};
+
+    s64 total_size = builder->total_size;
+
+    // NOTE: The blocks after the current one hold no content.
+    StringBuilder::StringBuilderBlock *flat = 0;
+    for (auto *before = builder->current; before->next; before = before->next) {
+        if (before->next->capacity >= total_size) {
+            flat = before->next;
+            before->next = flat->next;
+            break;
+        }
+    }
+
+    if (!flat) {
+        flat = (StringBuilder::StringBuilderBlock*)allocate(builder->allocator, sizeof(StringBuilder::StringBuilderBlock) + total_size);
+        flat->buffer   = (u8*)(flat + 1);
+        flat->capacity = total_size;
+    }
+
+    copy_content(builder, flat->buffer);
+    flat->used = total_size;
+
+    for (auto *old = &builder->first; old; old = old->next) {
+        old->used = 0;
+    }
 
-    return {builder->first.buffer, builder->first.used};
+    flat->next = builder->first.next;
+    builder->first.next = flat;
+    builder->current    = flat;
+
+    return {flat->buffer, flat->used};
 }
 
+// NOTE: Like to_string_view, but the flattened copy goes to temporary storage and the builder stays untouched.
+inline String temp_string(StringBuilder *builder) {
+    auto *block = single_block(builder);
+    if (block) return {block->buffer, block->used};
 
+    return to_allocated_string(builder, TempAllocator);
+}
@@ -0,0 +1,485 @@
+#include "text_buffer.h"
+
+
+INTERNAL s64 count_line_breaks(String text) {
+    s64 count = 0;
+
+    s64 index = find_first(text, '\n');
+    while (index != -1) {
+        count += 1;
+        text = shrink_front(text, index + 1);
+        index = find_first(text, '\n');
+    }
+
+    return count;
+}
+
+INTERNAL TextBufferNode *node(TextBuffer *buffer, s32 index) {
+    return &buffer->nodes[index];
+}
+
+INTERNAL String piece_text(TextBuffer *buffer, TextBufferNode *n) {
+    u8 *data = (n->source == TEXT_BUFFER_ORIGINAL) ? buffer->original.data : buffer->added.data;
+
+    return {data + n->start, n->size};
+}
+
+INTERNAL s64 subtree_size(TextBuffer *buffer, s32 index) {
+    return index == -1 ? 0 : node(buffer, index)->subtree_size;
+}
+
+INTERNAL s64 subtree_line_breaks(TextBuffer *buffer, s32 index) {
+    return index == -1 ? 0 : node(buffer, index)->subtree_line_breaks;
+}
+
+INTERNAL void update(TextBuffer *buffer, s32 index) {
+    TextBufferNode *n = node(buffer, index);
+
+    n->subtree_size        = n->size + subtree_size(buffer, n->left) + subtree_size(buffer, n->right);
+    n->subtree_line_breaks = n->line_breaks + subtree_line_breaks(buffer, n->left) + subtree_line_breaks(buffer, n->right);
+}
+
+INTERNAL u32 next_priority(TextBuffer *buffer) {
+    // NOTE: xorshift32, the priorities only need to be spread out.
+    u32 x = buffer->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    buffer->seed = x;
+
+    return x;
+}
+
+INTERNAL s32 new_node(TextBuffer *buffer, TextBufferSource source, s64 start, s64 size, s64 line_breaks) {
+    s32 index;
+    if (buffer->free_nodes.size) {
+        index = buffer->free_nodes[-1];
+        pop(&buffer->free_nodes);
+    } else {
+        index = (s32)buffer->nodes.size;
+        append(&buffer->nodes);
+    }
+
+    TextBufferNode *n = node(buffer, index);
+    n->left        = -1;
+    n->right       = -1;
+    n->priority    = next_priority(buffer);
+    n->source      = source;
+    n->start       = start;
+    n->size        = size;
+    n->line_breaks = line_breaks;
+    update(buffer, index);
+
+    return index;
+}
+
+INTERNAL void free_subtree(TextBuffer *buffer, s32 index) {
+    if (index == -1) return;
+
+    free_subtree(buffer, node(buffer, index)->left);
+    free_subtree(buffer, node(buffer, index)->right);
+    append(&buffer->free_nodes, index);
+}
+
+INTERNAL s32 merge(TextBuffer *buffer, s32 left, s32 right) {
+    if (left == -1)  return right;
+    if (right == -1) return left;
+
+    if (node(buffer, left)->priority > node(buffer, right)->priority) {
+        s32 merged = merge(buffer, node(buffer, left)->right, right);
+        node(buffer, left)->right = merged;
+        update(buffer, left);
+
+        return left;
+    } else {
+        s32 merged = merge(buffer, left, node(buffer, right)->left);
+        node(buffer, right)->left = merged;
+        update(buffer, right);
+
+        return right;
+    }
+}
+
+// NOTE: Splits the tree so that left holds the first pos bytes, a piece containing pos is cut in two.
+INTERNAL void split(TextBuffer *buffer, s32 index, s64 pos, s32 *left, s32 *right) {
+    if (index == -1) {
+        *left  = -1;
+        *right = -1;
+        return;
+    }
+
+    s64 left_size = subtree_size(buffer, node(buffer, index)->left);
+
+    if (pos <= left_size) {
+        s32 l, r;
+        split(buffer, node(buffer, index)->left, pos, &l, &r);
+        node(buffer, index)->left = r;
+        update(buffer, index);
+
+        *left  = l;
+        *right = index;
+    } else if (pos >= left_size + node(buffer, index)->size) {
+        s32 l, r;
+        split(buffer, node(buffer, index)->right, pos - left_size - node(buffer, index)->size, &l, &r);
+        node(buffer, index)->right = l;
+        update(buffer, index);
+
+        *left  = index;
+        *right = r;
+    } else {
+        // NOTE: Cut the piece, only the smaller half needs its line breaks counted.
+        TextBufferNode *n = node(buffer, index);
+        s64 offset = pos - left_size;
+        String text = piece_text(buffer, n);
+
+        s64 front_breaks;
+        if (offset <= n->size / 2) front_breaks = count_line_breaks(head_until(text, offset));
+        else                       front_breaks = n->line_breaks - count_line_breaks(shrink_front(text, offset));
+
+        s32 back = new_node(buffer, n->source, n->start + offset, n->size - offset, 0);
+        n = node(buffer, index); // NOTE: new_node can move the nodes.
+
+        // NOTE: Same priority as the cut node, its right subtree moves below the new one.
+        node(buffer, back)->priority    = n->priority;
+        node(buffer, back)->line_breaks = n->line_breaks - front_breaks;
+        node(buffer, back)->right       = n->right;
+        update(buffer, back);
+
+        n->size        = offset;
+        n->line_breaks = front_breaks;
+        n->right       = -1;
+        update(buffer, index);
+
+        *left  = index;
+        *right = back;
+    }
+}
+
+// NOTE: Builds a tree of pieces for a range of one source, capped at TEXT_BUFFER_MAX_PIECE each.
+INTERNAL s32 build_pieces(TextBuffer *buffer, TextBufferSource source, s64 start, s64 size) {
+    s32 result = -1;
+
+    String data = (source == TEXT_BUFFER_ORIGINAL) ? buffer->original : String{buffer->added.data, buffer->added.size};
+    while (size > 0) {
+        s64 piece_size = size < TEXT_BUFFER_MAX_PIECE ? size : TEXT_BUFFER_MAX_PIECE;
+        s64 line_breaks = count_line_breaks({data.data + start, piece_size});
+
+        result = merge(buffer, result, new_node(buffer, source, start, piece_size, line_breaks));
+        start += piece_size;
+        size  -= piece_size;
+    }
+
+    return result;
+}
+
+
+void init(TextBuffer *buffer, String content, Allocator alloc) {
+    destroy(buffer);
+
+    buffer->allocator = alloc;
+    buffer->original  = allocate_string(content, alloc);
+    buffer->root      = -1;
+    buffer->seed      = 0x9E3779B9;
+
+    buffer->added.allocator      = alloc;
+    buffer->nodes.allocator      = alloc;
+    buffer->free_nodes.allocator = alloc;
+
+    buffer->root = build_pieces(buffer, TEXT_BUFFER_ORIGINAL, 0, content.size);
+}
+
+void destroy(TextBuffer *buffer) {
+    if (buffer->allocator.allocate) {
+        destroy(&buffer->original, buffer->allocator);
+        destroy(&buffer->added);
+        destroy(&buffer->nodes);
+        destroy(&buffer->free_nodes);
+    }
+
+    INIT_STRUCT(buffer);
+    buffer->root = -1;
+}
+
+s64 text_size(TextBuffer *buffer) {
+    return subtree_size(buffer, buffer->root);
+}
+
+s64 line_count(TextBuffer *buffer) {
+    return subtree_line_breaks(buffer, buffer->root) + 1;
+}
+
+// NOTE: Grows the piece ending at the end of the tree, used when typing appends to the last insert.
+INTERNAL b32 extend_last_piece(TextBuffer *buffer, s32 index, s64 start, s64 size, s64 line_breaks) {
+    if (index == -1) return false;
+
+    TextBufferNode *n = node(buffer, index);
+    b32 extended = false;
+
+    if (n->right != -1) {
+        extended = extend_last_piece(buffer, n->right, start, size, line_breaks);
+    } else if (n->source == TEXT_BUFFER_ADDED && n->start + n->size == start && n->size + size <= TEXT_BUFFER_MAX_PIECE) {
+        n->size        += size;
+        n->line_breaks += line_breaks;
+        extended = true;
+    }
+
+    if (extended) update(buffer, index);
+
+    return extended;
+}
+
+void insert(TextBuffer *buffer, s64 pos, String text) {
+    assert(pos >= 0 && pos <= text_size(buffer));
+    if (text.size == 0) return;
+
+    s64 start = buffer->added.size;
+    append(&buffer->added, Array<u8>{text.data, text.size});
+
+    s32 left, right;
+    split(buffer, buffer->root, pos, &left, &right);
+
+    if (text.size > TEXT_BUFFER_MAX_PIECE || !extend_last_piece(buffer, left, start, text.size, count_line_breaks(text))) {
+        left = merge(buffer, left, build_pieces(buffer, TEXT_BUFFER_ADDED, start, text.size));
+    }
+
+    buffer->root = merge(buffer, left, right);
+}
+
+void remove(TextBuffer *buffer, s64 pos, s64 size) {
+    assert(pos >= 0 && size >= 0 && pos + size <= text_size(buffer));
+    if (size == 0) return;
+
+    s32 left, middle, right;
+    split(buffer, buffer->root, pos, &left, &right);
+    split(buffer, right, size, &middle, &right);
+
+    free_subtree(buffer, middle);
+    buffer->root = merge(buffer, left, right);
+}
+
+String chunk_at(TextBuffer *buffer, s64 pos) {
+    s32 index = buffer->root;
+
+    while (index != -1) {
+        TextBufferNode *n = node(buffer, index);
+        s64 left_size = subtree_size(buffer, n->left);
+
+        if (pos < left_size) {
+            index = n->left;
+        } else if (pos < left_size + n->size) {
+            return shrink_front(piece_text(buffer, n), pos - left_size);
+        } else {
+            pos  -= left_size + n->size;
+            index = n->right;
+        }
+    }
+
+    return {};
+}
+
+u8 byte_at(TextBuffer *buffer, s64 pos) {
+    String chunk = chunk_at(buffer, pos);
+    BOUNDS_CHECK(0, chunk.size - 1, 0, "TextBuffer read out of bounds");
+
+    return chunk.data[0];
+}
+
+void copy_range(TextBuffer *buffer, s64 pos, s64 size, u8 *out) {
+    while (size > 0) {
+        String chunk = chunk_at(buffer, pos);
+        assert(chunk.size > 0);
+
+        s64 bytes = chunk.size < size ? chunk.size : size;
+        copy_memory(out, chunk.data, bytes);
+
+        out  += bytes;
+        pos  += bytes;
+        size -= bytes;
+    }
+}
+
+// NOTE: Position right after the nth line break (1 based).
+INTERNAL s64 position_after_break(TextBuffer *buffer, s64 nth) {
+    s32 index = buffer->root;
+    s64 offset = 0;
+
+    while (index != -1) {
+        TextBufferNode *n = node(buffer, index);
+        s64 left_breaks = subtree_line_breaks(buffer, n->left);
+
+        if (nth <= left_breaks) {
+            index = n->left;
+            continue;
+        }
+
+        nth    -= left_breaks;
+        offset += subtree_size(buffer, n->left);
+
+        if (nth <= n->line_breaks) {
+            String text = piece_text(buffer, n);
+
+            s64 consumed = 0;
+            while (nth > 0) {
+                consumed += find_first(tail_from(text, consumed), '\n') + 1;
+                nth -= 1;
+            }
+
+            return offset + consumed;
+        }
+
+        nth    -= n->line_breaks;
+        offset += n->size;
+        index   = n->right;
+    }
+
+    return offset;
+}
+
+s64 line_start(TextBuffer *buffer, s64 line) {
+    assert(line >= 0 && line < line_count(buffer));
+    if (line == 0) return 0;
+
+    return position_after_break(buffer, line);
+}
+
+s64 line_end(TextBuffer *buffer, s64 line) {
+    assert(line >= 0 && line < line_count(buffer));
+    if (line == line_count(buffer) - 1) return text_size(buffer);
+
+    return position_after_break(buffer, line + 1) - 1;
+}
+
+s64 line_of(TextBuffer *buffer, s64 pos) {
+    assert(pos >= 0 && pos <= text_size(buffer));
+
+    s32 index = buffer->root;
+    s64 line = 0;
+
+    while (index != -1) {
+        TextBufferNode *n = node(buffer, index);
+        s64 left_size = subtree_size(buffer, n->left);
+
+        if (pos < left_size) {
+            index = n->left;
+        } else if (pos < left_size + n->size) {
+            return line + subtree_line_breaks(buffer, n->left) + count_line_breaks(head_until(piece_text(buffer, n), pos - left_size));
+        } else {
+            line += subtree_line_breaks(buffer, n->left) + n->line_breaks;
+            pos  -= left_size + n->size;
+            index = n->right;
+        }
+    }
+
+    return line;
+}
+
+String line_text(TextBuffer *buffer, s64 line, Allocator alloc) {
+    s64 start = line_start(buffer, line);
+    s64 size  = line_end(buffer, line) - start;
+
+    String chunk = chunk_at(buffer, start);
+    String result;
+    if (chunk.size >= size) {
+        result = head_until(chunk, size);
+    } else {
+        result = allocate_string(size, alloc);
+        copy_range(buffer, start, size, result.data);
+    }
+
+    if (result.size && result[result.size - 1] == '\r') result.size -= 1;
+
+    return result;
+}
+
+
+INTERNAL b32 is_continuation_byte(u8 c) {
+    return (c & 0xC0) == 0x80;
+}
+
+s64 next_position(TextBuffer *buffer, s64 pos) {
+    s64 size = text_size(buffer);
+    if (pos >= size) return size;
+
+    pos += 1;
+    while (pos < size && is_continuation_byte(byte_at(buffer, pos))) pos += 1;
+
+    return pos;
+}
+
+s64 previous_position(TextBuffer *buffer, s64 pos) {
+    if (pos <= 0) return 0;
+
+    pos -= 1;
+    while (pos > 0 && is_continuation_byte(byte_at(buffer, pos))) pos -= 1;
+
+    return pos;
+}
+
+INTERNAL s64 column_of(TextBuffer *buffer, s64 pos) {
+    s64 start = line_start(buffer, line_of(buffer, pos));
+
+    s64 column = 0;
+    while (start < pos) {
+        start   = next_position(buffer, start);
+        column += 1;
+    }
+
+    return column;
+}
+
+INTERNAL s64 position_in_line(TextBuffer *buffer, s64 line, s64 column) {
+    s64 pos = line_start(buffer, line);
+    s64 end = line_end(buffer, line);
+
+    while (column > 0 && pos < end) {
+        pos     = next_position(buffer, pos);
+        column -= 1;
+    }
+
+    return pos;
+}
+
+void move_cursor(TextBuffer *buffer, TextCursor *cursor, TextCursorMove move) {
+    s64 line = line_of(buffer, cursor->pos);
+
+    switch (move) {
+    case TEXT_CURSOR_LEFT:       cursor->pos = previous_position(buffer, cursor->pos); break;
+    case TEXT_CURSOR_RIGHT:      cursor->pos = next_position(buffer, cursor->pos);     break;
+    case TEXT_CURSOR_LINE_START: cursor->pos = line_start(buffer, line);               break;
+    case TEXT_CURSOR_LINE_END:   cursor->pos = line_end(buffer, line);                 break;
+
+    case TEXT_CURSOR_UP:
+    case TEXT_CURSOR_DOWN: {
+        if (cursor->preferred_column < 0) cursor->preferred_column = column_of(buffer, cursor->pos);
+
+        s64 target = (move == TEXT_CURSOR_UP) ? line - 1 : line + 1;
+        if (target < 0 || target >= line_count(buffer)) return;
+
+        cursor->pos = position_in_line(buffer, target, cursor->preferred_column);
+    } return; // NOTE: Keeps the preferred column.
+    }
+
+    cursor->preferred_column = -1;
+}
+
+void insert_at_cursor(TextBuffer *buffer, TextCursor *cursor, String text) {
+    insert(buffer, cursor->pos, text);
+
+    cursor->pos += text.size;
+    cursor->preferred_column = -1;
+}
+
+void delete_backward(TextBuffer *buffer, TextCursor *cursor) {
+    s64 start = previous_position(buffer, cursor->pos);
+    remove(buffer, start, cursor->pos - start);
+
+    cursor->pos = start;
+    cursor->preferred_column = -1;
+}
+
+void delete_forward(TextBuffer *buffer, TextCursor *cursor) {
+    s64 end = next_position(buffer, cursor->pos);
+    remove(buffer, cursor->pos, end - cursor->pos);
+
+    cursor->preferred_column = -1;
+}
@@ -0,0 +1,110 @@
+//================================================
+// A TextBuffer is a piece table for editing big
+// texts. The content is never moved, the original
+// text and everything inserted later are kept in
+// two buffers and the document is a sequence of
+// pieces pointing into them.
+//
+// The pieces live in a treap ordered by position,
+// every node knows the bytes and line breaks of its
+// subtree. Inserting, removing and finding lines
+// are O(log n) in the number of pieces.
+//
+// Positions are byte offsets into the document and
+// lines are 0 based. Pieces are capped to
+// TEXT_BUFFER_MAX_PIECE bytes so counting the line
+// breaks of a split piece stays cheap.
+//================================================
+#pragma once
+
+#include "definitions.h"
+#include "list.h"
+#include "string2.h"
+
+
+#ifndef TEXT_BUFFER_MAX_PIECE
+#define TEXT_BUFFER_MAX_PIECE KILOBYTES(16)
+#endif
+
+enum TextBufferSource : u8 {
+    TEXT_BUFFER_ORIGINAL,
+    TEXT_BUFFER_ADDED,
+};
+
+struct TextBufferNode {
+    s32 left;
+    s32 right;
+    u32 priority;
+
+    TextBufferSource source;
+    s64 start;
+    s64 size;
+    s64 line_breaks;
+
+    s64 subtree_size;
+    s64 subtree_line_breaks;
+};
+
+struct TextBuffer {
+    Allocator allocator;
+
+    String   original;
+    List<u8> added;
+
+    List<TextBufferNode> nodes;
+    List<s32> free_nodes;
+
+    s32 root; // NOTE: -1 if the buffer is empty.
+    u32 seed;
+};
+
+void init(TextBuffer *buffer, String content = {}, Allocator alloc = DefaultAllocator);
+void destroy(TextBuffer *buffer);
+
+s64 text_size(TextBuffer *buffer);
+s64 line_count(TextBuffer *buffer);
+
+void insert(TextBuffer *buffer, s64 pos, String text);
+void remove(TextBuffer *buffer, s64 pos, s64 size);
+
+u8  byte_at(TextBuffer *buffer, s64 pos);
+
+// NOTE: The contiguous text starting at pos up to the end of its piece, empty at the end.
+String chunk_at(TextBuffer *buffer, s64 pos);
+void   copy_range(TextBuffer *buffer, s64 pos, s64 size, u8 *out);
+
+s64 line_start(TextBuffer *buffer, s64 line);
+// NOTE: Position of the line break ending the line or the end of the text for the last line.
+s64 line_end(TextBuffer *buffer, s64 line);
+s64 line_of(TextBuffer *buffer, s64 pos);
+
+// NOTE: Without the line break, allocated with alloc if the line spans multiple pieces.
+String line_text(TextBuffer *buffer, s64 line, Allocator alloc = TempAllocator);
+
+
+//================================================
+// Cursor movement steps over whole UTF-8 sequences.
+// Moving up and down tries to keep the column the
+// cursor had before, counted in codepoints.
+//================================================
+enum TextCursorMove {
+    TEXT_CURSOR_LEFT,
+    TEXT_CURSOR_RIGHT,
+    TEXT_CURSOR_UP,
+    TEXT_CURSOR_DOWN,
+    TEXT_CURSOR_LINE_START,
+    TEXT_CURSOR_LINE_END,
+};
+
+struct TextCursor {
+    s64 pos;
+    s64 preferred_column; // NOTE: -1 if not moved vertically yet.
+};
+
+s64  next_position(TextBuffer *buffer, s64 pos);
+s64  previous_position(TextBuffer *buffer, s64 pos);
+
+void move_cursor(TextBuffer *buffer, TextCursor *cursor, TextCursorMove move);
+void insert_at_cursor(TextBuffer *buffer, TextCursor *cursor, String text);
+void delete_backward(TextBuffer *buffer, TextCursor *cursor);
+void delete_forward(TextBuffer *buffer, TextCursor *cursor);
@@ -1,6 +1,9 @@
 #include "ui.h"
 
+#include "string2.h"
 #include "utf.h"
+#include "hash_table.h"
+#include "atomic.h"
 
 
 
@@ -44,25 +47,42 @@ INTERNAL ButtonState click_info(UI *ui, void *id) {
     return state;
 }
 
-INTERNAL String duplicate(UI *ui, String str) {
-    if (str.size == 0) return {};
-
-    u8 *tmp = (u8*)allocate_from_arena(&ui->per_frame_memory, str.size, 0, 0);
-    copy_memory(tmp, str.data, str.size);
-    str.data = tmp;
-
-    return str;
-}
-
 INTERNAL void default_frame_func(UI *ui) {
 }
 INTERNAL r32 DefaultFontHeight = pt(16.0f);
 INTERNAL u32 DefaultFontColor  = PACK_RGB(210, 210, 210);
 
 
-void init(UI *ui, s64 memory, UIFrameFunc *initial_frame) {
+// NOTE: Windows may be finished on other threads, the counters are shared.
+INTERNAL void *ui_allocate(void *data, s64 size, void *old, s64 old_size) {
+    UI *ui = (UI*)data;
+
+    if (size) {
+        atomic_add(&ui->allocations, 1);
+        atomic_add(&ui->allocated_bytes, size);
+    }
+
+    return ui->allocator.allocate(ui->allocator.data, size, old, old_size);
+}
+
+INTERNAL void set_allocator(UIWindow *window, Allocator alloc) {
+    window->tasks.allocator          = alloc;
+    window->hittests.allocator       = alloc;
+    window->hit_grid.cells.allocator = alloc;
+    window->hit_grid.nodes.allocator = alloc;
+    window->layouts.allocator        = alloc;
+    window->quads.allocator          = alloc;
+    window->batch_quads.allocator    = alloc;
+    window->batches.allocator        = alloc;
+    window->batch_parts.allocator    = alloc;
+    window->text_commands.allocator  = alloc;
+    window->text_bytes.allocator     = alloc;
+    window->last_tasks.allocator     = alloc;
+    window->last_quads.allocator     = alloc;
+}
+
+void init(UI *ui, s64 memory, UIFrameFunc *initial_frame, Allocator alloc) {
     UI new_ui = {};
-    new_ui.current_window = &new_ui.viewport;
     init(&new_ui.per_frame_memory, memory);
 
     if (initial_frame) {
@@ -71,7 +91,18 @@ void init(UI *ui, s64 memory, UIFrameFunc *initial_frame) {
         new_ui.frame_func = default_frame_func;
     }
 
+    new_ui.allocator = alloc.allocate ? alloc : DefaultAllocator;
+
     *ui = new_ui;
+    ui->current_window = &ui->viewport;
+
+    Allocator counted = {ui_allocate, ui};
+    set_allocator(&ui->viewport, counted);
+    ui->windows.allocator     = counted;
+    ui->fonts.allocator       = counted;
+    ui->clip_stack.allocator  = counted;
+    ui->quad_buffer.allocator = counted;
+    init(&ui->layout_cache, 6, counted);
 }
 
 s32 add_font(UI *ui, UIFont font) {
@@ -90,18 +121,71 @@ INTERNAL b32 cursor_in_rect(UI *ui, UIRect rect) {
     return p.x >= rect.x && p.y >= rect.y && p.x < x1 && p.y < y1;
 }
 
-INTERNAL void *hovered_element(UI *ui) {
-    // TODO: Put last active window at the back?
-    FOR (ui->windows, window) {
-        for (s64 i = -1; i >= -window->hittests.size; i -= 1) {
-            UIHittest *hit = &window->hittests[i];
+INTERNAL s32 const UIHitCellSize = 64;
+INTERNAL s32 const UIHitMaxCells = 128; // NOTE: Per axis, bigger windows get bigger cells at the border.
+
+INTERNAL void reset_hit_grid(UIHitGrid *grid, UIRect region) {
+    grid->origin  = {region.x, region.y};
+    grid->columns = (region.w + UIHitCellSize - 1) / UIHitCellSize;
+    grid->rows    = (region.h + UIHitCellSize - 1) / UIHitCellSize;
+
+    if (grid->columns < 1)             grid->columns = 1;
+    if (grid->rows < 1)                grid->rows    = 1;
+    if (grid->columns > UIHitMaxCells) grid->columns = UIHitMaxCells;
+    if (grid->rows > UIHitMaxCells)    grid->rows    = UIHitMaxCells;
+
+    s64 cell_count = grid->columns * grid->rows;
+    maybe_grow(&grid->cells, cell_count);
+    grid->cells.size = cell_count;
+    FOR (grid->cells, cell) {
+        *cell = -1;
+    }
+
+    grid->nodes.size = 0;
+}
+
+// NOTE: Positions outside the grid map to the border cells, rects reaching outside are put there as well.
+INTERNAL s32 hit_column(UIHitGrid *grid, s32 x) {
+    s32 column = x < grid->origin.x ? 0 : (x - grid->origin.x) / UIHitCellSize;
+    return column < grid->columns ? column : grid->columns - 1;
+}
+
+INTERNAL s32 hit_row(UIHitGrid *grid, s32 y) {
+    s32 row = y < grid->origin.y ? 0 : (y - grid->origin.y) / UIHitCellSize;
+    return row < grid->rows ? row : grid->rows - 1;
+}
+
+INTERNAL void add_to_hit_grid(UIWindow *window, s32 hittest, UIRect rect) {
+    UIHitGrid *grid = &window->hit_grid;
+    if (grid->cells.size == 0) reset_hit_grid(grid, window->region);
+
+    if (rect.w <= 0 || rect.h <= 0) return;
+
+    s32 column0 = hit_column(grid, rect.x);
+    s32 column1 = hit_column(grid, rect.x + rect.w - 1);
+    s32 row0    = hit_row(grid, rect.y);
+    s32 row1    = hit_row(grid, rect.y + rect.h - 1);
 
-            if (cursor_in_rect(ui, hit->rect)) return hit->id;
+    ensure_space(&grid->nodes, (column1 - column0 + 1) * (row1 - row0 + 1));
+    for (s32 row = row0; row <= row1; row += 1) {
+        for (s32 column = column0; column <= column1; column += 1) {
+            s32 *cell = &grid->cells[row * grid->columns + column];
+
+            append(&grid->nodes, {hittest, *cell});
+            *cell = (s32)grid->nodes.size - 1;
         }
     }
+}
+
+INTERNAL void *hovered_element(UI *ui, UIWindow *window) {
+    UIHitGrid *grid = &window->hit_grid;
+    if (grid->cells.size == 0) return 0;
 
-    for (s64 i = -1; i >= -ui->viewport.hittests.size; i -= 1) {
-        UIHittest *hit = &ui->viewport.hittests[i];
+    Point p = ui->input->mouse.cursor_pos;
+    s32 cell = grid->cells[hit_row(grid, p.y) * grid->columns + hit_column(grid, p.x)];
+
+    for (s32 node = cell; node != -1; node = grid->nodes[node].next) {
+        UIHittest *hit = &window->hittests[grid->nodes[node].hittest];
 
         if (cursor_in_rect(ui, hit->rect)) return hit->id;
     }
@@ -109,42 +193,139 @@ INTERNAL void *hovered_element(UI *ui) {
     return 0;
 }
 
-// TODO: Concatenate tasks that have the same kind and texture.
-INTERNAL UITask *create_new_task(UI *ui, UITaskKind kind) {
+INTERNAL void *hovered_element(UI *ui) {
+    // TODO: Put last active window at the back?
+    FOR (ui->windows, window) {
+        void *id = hovered_element(ui, window);
+        if (id) return id;
+    }
+
+    return hovered_element(ui, &ui->viewport);
+}
+
+INTERNAL b32 compatible_tasks(UITask *a, UITask *b) {
+    if (a->kind != b->kind) return false;
+    if (a->kind == UI_TASK_TEXT && a->text.font_id != b->text.font_id) return false;
+
+    return a->kind == UI_TASK_GEOMETRY || a->kind == UI_TASK_TEXT;
+}
+
+// NOTE: Continues the last task if it is compatible and its quads are the last ones.
+INTERNAL UITask *create_new_task(UI *ui, UITaskKind kind, s32 font_id = 0) {
     UITask task = {};
     task.kind  = kind;
-    task.start = ui->vertex_buffer.size;
-    
-    return append(&ui->current_window->tasks, task);
+    task.start = ui->current_window->quads.size;
+    if (kind == UI_TASK_TEXT) task.text.font_id = font_id;
+
+    List<UITask> *tasks = &ui->current_window->tasks;
+    if (tasks->size) {
+        UITask *last = &(*tasks)[-1];
+        if (!last->underlay && compatible_tasks(last, &task) && last->start + last->count == task.start) return last;
+    }
+
+    return append(tasks, task);
 }
 
-// TODO: This is problematic because you can't add vertices to two different
-//       tasks at the same time or the indices will overlap.
-INTERNAL UITask *create_new_task_before(UI *ui, UITaskKind kind) {
+// NOTE: The task is drawn below the one before it, like a cursor below the text.
+INTERNAL UITask *create_underlay_task(UI *ui, UITaskKind kind) {
     UITask task = {};
-    task.kind  = kind;
-    task.start = ui->vertex_buffer.size;
-    
-    return insert(&ui->current_window->tasks, -1, task);
+    task.kind     = kind;
+    task.start    = ui->current_window->quads.size;
+    task.underlay = true;
+
+    return append(&ui->current_window->tasks, task);
 }
 
+//===============================================
+// Clipping happens on the CPU. Quads completely
+// outside the clip rect are never emitted, quads
+// crossing its border are cut and their texture
+// coordinates adjusted, so renderers need no
+// scissor. Define UI_GPU_CLIPPING to get clipping
+// tasks instead, quads crossing the border are
+// then left to the scissor.
+//===============================================
+#ifdef UI_GPU_CLIPPING
 INTERNAL void generate_clip_task(UI *ui, UIRect rect) {
     UITask *task = create_new_task(ui, UI_TASK_CLIPPING);
     task->clipping.area = rect;
 }
+#endif
+
+INTERNAL void set_clip(UI *ui, UIRect rect) {
+    ui->clip = rect;
+
+#ifdef UI_GPU_CLIPPING
+    generate_clip_task(ui, rect);
+#endif
+}
+
+// NOTE: Cuts a texture coordinate range like its edge was moved from a0 to cut.
+INTERNAL u16 cut_coordinate(u16 t0, u16 t1, s32 a0, s32 a1, s32 cut) {
+    return (u16)(t0 + (s64)(t1 - t0) * (cut - a0) / (a1 - a0));
+}
+
+// NOTE: Returns false if nothing of the quad is visible.
+INTERNAL b32 clip_quad(UIRect clip, UIQuad *quad) {
+    s32 cx0 = clip.x;
+    s32 cy0 = clip.y;
+    s32 cx1 = clip.x + clip.w;
+    s32 cy1 = clip.y + clip.h;
+
+    if (quad->x1 <= cx0 || quad->x0 >= cx1 || quad->y1 <= cy0 || quad->y0 >= cy1) return false;
+    if (quad->x1 <= quad->x0 || quad->y1 <= quad->y0) return false;
 
+#ifndef UI_GPU_CLIPPING
+    if (quad->x0 < cx0) {
+        quad->u0 = cut_coordinate(quad->u0, quad->u1, quad->x0, quad->x1, cx0);
+        quad->x0 = (s16)cx0;
+    }
+    if (quad->x1 > cx1) {
+        quad->u1 = cut_coordinate(quad->u1, quad->u0, quad->x1, quad->x0, cx1);
+        quad->x1 = (s16)cx1;
+    }
+    if (quad->y0 < cy0) {
+        quad->v0 = cut_coordinate(quad->v0, quad->v1, quad->y0, quad->y1, cy0);
+        quad->y0 = (s16)cy0;
+    }
+    if (quad->y1 > cy1) {
+        quad->v1 = cut_coordinate(quad->v1, quad->v0, quad->y1, quad->y0, cy1);
+        quad->y1 = (s16)cy1;
+    }
+#endif
+
+    return true;
+}
 
 INTERNAL void prepare_window(UIWindow *window) {
     window->tasks.size    = 0;
     window->hittests.size = 0;
+    window->layouts.size  = 0;
+    window->quads.size    = 0;
+    window->text_commands.size = 0;
+    window->text_bytes.size    = 0;
+    reset_hit_grid(&window->hit_grid, window->region);
 
     window->widget_cursor = {0, 0};
 }
 
+INTERNAL void prepare_windows(UI *ui) {
+    prepare_window(&ui->viewport);
+    FOR (ui->windows, window) {
+        prepare_window(window);
+    }
+}
+
+INTERNAL void keep_last_output(UIWindow *window);
+
 INTERNAL void push_clipping(UI *ui, UIRect rect) {
     append(&ui->clip_stack, rect);
 
-    generate_clip_task(ui, rect);
+    set_clip(ui, rect);
+}
+
+INTERNAL b32 overlaps_clip(UI *ui, s32 y, s32 height) {
+    return y + height > ui->clip.y && y < ui->clip.y + ui->clip.h;
 }
 
 INTERNAL void pop_clipping(UI *ui) {
@@ -152,33 +333,542 @@ INTERNAL void pop_clipping(UI *ui) {
     pop(&ui->clip_stack);
 
     if (ui->clip_stack.size > 0) {
-        generate_clip_task(ui, ui->clip_stack[-1]);
+        set_clip(ui, ui->clip_stack[-1]);
+    } else {
+        set_clip(ui, ui->viewport.region);
+    }
+}
+
+//===============================================
+// Batching runs once at the end of the frame and
+// merges the tasks of every window into as few
+// draw calls as possible. Within one clip area a
+// task may move back into an earlier compatible
+// batch as long as it doesn't overlap anything
+// drawn in between, so the result looks the same.
+//
+// The quads are copied into batch_quads in the
+// new order and the buffers are swapped.
+//===============================================
+struct UIBatch {
+    UITask task;
+    UIRect bounds;
+
+    s32 first_part;
+    s32 last_part;
+};
+
+struct UIBatcher {
+    UITask *tasks;
+    s32    *next_part;
+
+    UIBatch *batches;
+    s64      batch_count;
+    s64      segment_start; // NOTE: First batch after the last clip.
+
+    UIQuad *quads;
+};
+
+// NOTE: How many batches a task may move back, keeps batching linear in the task count.
+INTERNAL s64 const UIBatchLookback = 16;
+
+INTERNAL UIRect quad_bounds(UIQuad *quads, s64 count) {
+    s32 x0 = quads[0].x0;
+    s32 y0 = quads[0].y0;
+    s32 x1 = quads[0].x1;
+    s32 y1 = quads[0].y1;
+
+    for (s64 i = 1; i < count; i += 1) {
+        if (quads[i].x0 < x0) x0 = quads[i].x0;
+        if (quads[i].y0 < y0) y0 = quads[i].y0;
+        if (quads[i].x1 > x1) x1 = quads[i].x1;
+        if (quads[i].y1 > y1) y1 = quads[i].y1;
+    }
+
+    return {x0, y0, x1 - x0, y1 - y0};
+}
+
+INTERNAL b32 rects_overlap(UIRect a, UIRect b) {
+    return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+INTERNAL UIRect merge_rects(UIRect a, UIRect b) {
+    s32 x0 = a.x < b.x ? a.x : b.x;
+    s32 y0 = a.y < b.y ? a.y : b.y;
+    s32 x1 = a.x + a.w > b.x + b.w ? a.x + a.w : b.x + b.w;
+    s32 y1 = a.y + a.h > b.y + b.h ? a.y + a.h : b.y + b.h;
+
+    return {x0, y0, x1 - x0, y1 - y0};
+}
+
+INTERNAL void add_to_batch(UIBatcher *batcher, s64 index) {
+    UITask *task = &batcher->tasks[index];
+    batcher->next_part[index] = -1;
+
+    if (task->kind == UI_TASK_CLIPPING) {
+        // NOTE: Only the last of consecutive clips matters.
+        if (batcher->batch_count && batcher->batches[batcher->batch_count - 1].task.kind == UI_TASK_CLIPPING) {
+            batcher->batches[batcher->batch_count - 1].task = *task;
+            return;
+        }
+
+        UIBatch *batch = &batcher->batches[batcher->batch_count];
+        INIT_STRUCT(batch);
+        batch->task       = *task;
+        batch->first_part = -1;
+
+        batcher->batch_count  += 1;
+        batcher->segment_start = batcher->batch_count;
+
+        return;
+    }
+
+    if (task->count == 0) return;
+
+    UIRect bounds = quad_bounds(batcher->quads + task->start, task->count);
+
+    s64 lookback_end = batcher->batch_count - UIBatchLookback;
+    if (lookback_end < batcher->segment_start) lookback_end = batcher->segment_start;
+
+    for (s64 i = batcher->batch_count - 1; i >= lookback_end; i -= 1) {
+        UIBatch *batch = &batcher->batches[i];
+
+        if (compatible_tasks(&batch->task, task)) {
+            batcher->next_part[batch->last_part] = (s32)index;
+            batch->last_part   = (s32)index;
+            batch->task.count += task->count;
+            batch->bounds      = merge_rects(batch->bounds, bounds);
+
+            return;
+        }
+
+        if (rects_overlap(batch->bounds, bounds)) break;
+    }
+
+    UIBatch *batch = &batcher->batches[batcher->batch_count];
+    batch->task          = *task;
+    batch->task.underlay = false;
+    batch->bounds        = bounds;
+    batch->first_part    = (s32)index;
+    batch->last_part     = (s32)index;
+
+    batcher->batch_count += 1;
+}
+
+INTERNAL void batch_tasks(UIWindow *window) {
+    s64 count = window->tasks.size;
+    if (count == 0) return;
+
+    // NOTE: Kept between frames, big UIs easily have more tasks than fit into temporary storage.
+    maybe_grow(&window->batches, count);
+    maybe_grow(&window->batch_parts, count);
+
+    UIBatcher batcher = {};
+    batcher.tasks     = window->tasks.data;
+    batcher.next_part = window->batch_parts.data;
+    batcher.batches   = window->batches.data;
+    batcher.quads     = window->quads.data;
+
+    for (s64 i = 0; i < count; i += 1) {
+        if (i + 1 < count && batcher.tasks[i + 1].underlay) {
+            add_to_batch(&batcher, i + 1);
+            add_to_batch(&batcher, i);
+            i += 1;
+        } else {
+            add_to_batch(&batcher, i);
+        }
+    }
+
+    List<UIQuad> *out = &window->batch_quads;
+    out->size = 0;
+    ensure_space(out, window->quads.size);
+
+    for (s64 i = 0; i < batcher.batch_count; i += 1) {
+        UIBatch *batch = &batcher.batches[i];
+
+        batch->task.start = out->size;
+        for (s32 part = batch->first_part; part != -1; part = batcher.next_part[part]) {
+            UITask *task = &batcher.tasks[part];
+
+            copy_memory(out->data + out->size, batcher.quads + task->start, task->count * sizeof(UIQuad));
+            out->size += task->count;
+        }
+
+        window->tasks[i] = batch->task;
+    }
+
+    window->tasks.size = batcher.batch_count;
+
+    List<UIQuad> tmp    = window->quads;
+    window->quads       = window->batch_quads;
+    window->batch_quads = tmp;
+}
+
+INTERNAL u64 content_hash(u64 h, void const *data, s64 size) {
+    u8 const *bytes = (u8 const*)data;
+
+    while (size >= 8) {
+        u64 word;
+        copy_memory(&word, bytes, 8);
+
+        h = (h ^ word) * 0x100000001b3ull;
+        h ^= h >> 29;
+
+        bytes += 8;
+        size  -= 8;
+    }
+
+    while (size) {
+        h = (h ^ *bytes) * 0x100000001b3ull;
+
+        bytes += 1;
+        size  -= 1;
+    }
+
+    return basic_hash(&h);
+}
+
+// NOTE: Task starts are left out, they move when a window before this one changes.
+INTERNAL void update_content_hash(UIWindow *window) {
+    u64 h = 0x100;
+
+    FOR (window->tasks, task) {
+        h = content_hash(h, &task->kind, sizeof(task->kind));
+        h = content_hash(h, &task->count, sizeof(task->count));
+
+        if (task->kind == UI_TASK_CLIPPING) h = content_hash(h, &task->clipping.area, sizeof(task->clipping.area));
+        if (task->kind == UI_TASK_TEXT)     h = content_hash(h, &task->text.font_id, sizeof(task->text.font_id));
+    }
+
+    h = content_hash(h, window->quads.data, window->quads.size * sizeof(UIQuad));
+
+    window->changed      = h != window->content_hash;
+    window->content_hash = h;
+}
+
+// NOTE: Moves the output of the last frame aside before the windows record again.
+INTERNAL void keep_last_output(UIWindow *window) {
+    List<UITask> tasks = window->tasks;
+    window->tasks      = window->last_tasks;
+    window->last_tasks = tasks;
+
+    List<UIQuad> quads = window->quads;
+    window->quads      = window->last_quads;
+    window->last_quads = quads;
+}
+
+INTERNAL void generate_text(UI *ui, UIWindow *window);
+INTERNAL u64  recorded_hash(UIWindow *window);
+
+struct UIFinishContext {
+    UI *ui;
+    UIWindow **windows;
+};
+
+INTERNAL void finish_window(void *context, s64 index) {
+    UIFinishContext *finish = (UIFinishContext*)context;
+    UIWindow *window = finish->windows[index];
+
+    u64 recorded = recorded_hash(window);
+    if (window->finished && recorded == window->recorded_hash) {
+        // NOTE: Recorded the same as last frame, take its tasks and quads instead of generating the text and batching again.
+        // NOTE: quad_start is still the one of last frame, the starts are made relative to the window again.
+        keep_last_output(window);
+
+        FOR (window->tasks, task) {
+            task->start -= window->quad_start;
+        }
+
+        window->changed = false;
+        return;
+    }
+
+    generate_text(finish->ui, window);
+    batch_tasks(window);
+    update_content_hash(window);
+
+    window->recorded_hash = recorded;
+    window->finished      = true;
+}
+
+// NOTE: Fonts load glyphs on a miss, which usually isn't safe while another thread looks one up.
+INTERNAL b32 fonts_thread_safe(UI *ui) {
+    FOR (ui->fonts, font) {
+        if (!font->thread_safe) return false;
+    }
+
+    return true;
+}
+
+// NOTE: Finishes every window on its own and puts their quads after each other into the
+//       quad_buffer afterwards. Returns true if any window changed.
+INTERNAL b32 finish_windows(UI *ui) {
+    SCOPE_TEMP_STORAGE();
+
+    s64 count = ui->windows.size + 1;
+    UIWindow **windows = ALLOC(TempAllocator, UIWindow*, count);
+
+    windows[0] = &ui->viewport;
+    for (s64 i = 0; i < ui->windows.size; i += 1) {
+        windows[i + 1] = &ui->windows[i];
+    }
+
+    UIFinishContext context = {ui, windows};
+    if (ui->parallel_for && count > 1 && fonts_thread_safe(ui)) {
+        ui->parallel_for(ui->parallel_data, count, finish_window, &context);
+    } else {
+        for (s64 i = 0; i < count; i += 1) {
+            finish_window(&context, i);
+        }
+    }
+
+    b32 changed = false;
+
+    ui->quad_buffer.size = 0;
+    for (s64 i = 0; i < count; i += 1) {
+        UIWindow *window = windows[i];
+
+        window->quad_start = ui->quad_buffer.size;
+        window->quad_count = window->quads.size;
+
+        FOR (window->tasks, task) {
+            task->start += window->quad_start;
+        }
+
+        ensure_space(&ui->quad_buffer, window->quads.size);
+        copy_memory(ui->quad_buffer.data + ui->quad_buffer.size, window->quads.data, window->quads.size * sizeof(UIQuad));
+        ui->quad_buffer.size += window->quads.size;
+
+        changed |= window->changed;
+    }
+
+    return changed;
+}
+
+INTERNAL b32 same_mouse(UserMouseInput *a, UserMouseInput *b) {
+    if (a->cursor_pos.x != b->cursor_pos.x || a->cursor_pos.y != b->cursor_pos.y) return false;
+    if (a->scroll != b->scroll) return false;
+
+    for (s32 i = 0; i < MOUSE_KEY_COUNT; i += 1) {
+        if (!a->keys[i] != !b->keys[i]) return false;
+    }
+
+    return true;
+}
+
+// NOTE: Nothing happened since the last frame that could change what it draws.
+INTERNAL b32 idle_frame(UI *ui, V2i window_size, UserInput *input) {
+    if (!ui->skip_idle_frames || ui->invalidated) return false;
+    if (ui->viewport.changed) return false;
+    FOR (ui->windows, window) {
+        if (window->changed) return false;
+    }
+
+    if (window_size.w != ui->last_frame_size.w || window_size.h != ui->last_frame_size.h) return false;
+    if (input->actions.used || input->mouse.scroll) return false;
+
+    return same_mouse(&input->mouse, &ui->last_frame_mouse);
+}
+
+void invalidate(UI *ui) {
+    ui->invalidated = true;
+}
+
+INTERNAL u64 layout_key(u64 layout, void *id) {
+    u64 key = layout ^ (u64)id;
+    return basic_hash(&key);
+}
+
+INTERNAL UILayoutNode *layout_node(UI *ui, u64 key) {
+    UILayoutNode *node = upsert(&ui->layout_cache, key);
+
+    if (node->frame != ui->frame_index) {
+        node->frame = ui->frame_index;
+        ui->layout_nodes_used += 1;
+    }
+
+    return node;
+}
+
+// NOTE: The cache can't remove single entries, once most of it is unused it is rebuilt from the nodes of this frame.
+INTERNAL void prune_layout_cache(UI *ui) {
+    s64 const min_nodes = 256;
+
+    HashTable<u64, UILayoutNode> *cache = &ui->layout_cache;
+    if (cache->used < min_nodes || cache->used < ui->layout_nodes_used * 4) return;
+
+    HashTable<u64, UILayoutNode> pruned = {};
+    init(&pruned, 6, cache->allocator);
+    for (s64 i = 0; i < cache->alloc; i += 1) {
+        auto *entry = &cache->entries[i];
+
+        if (entry->hash >= cache->FirstValidHash && entry->value.frame == ui->frame_index) {
+            insert(&pruned, entry->key, entry->value);
+        }
+    }
+
+    destroy(cache);
+    *cache = pruned;
+}
+
+INTERNAL UILayout *current_layout(UI *ui) {
+    UIWindow *window = ui->current_window;
+    return window->layouts.size ? &window->layouts[-1] : 0;
+}
+
+void begin_layout(UI *ui, void *id, UILayoutDirection direction, UIRect area, s32 spacing) {
+    UILayout *parent = current_layout(ui);
+
+    UILayout layout = {};
+    layout.id        = layout_key(parent ? parent->id : 0, id);
+    layout.direction = direction;
+    layout.area      = area;
+    layout.spacing   = spacing;
+    layout.cursor    = {area.x, area.y};
+
+    if (UILayoutNode *node = find(&ui->layout_cache, layout.id)) layout.last = *node;
+
+    append(&ui->current_window->layouts, layout);
+}
+
+void end_layout(UI *ui) {
+    UIWindow *window = ui->current_window;
+    assert(window->layouts.size > 0);
+
+    UILayout *layout = &window->layouts[-1];
+
+    // NOTE: Widgets only place themselves while drawing, the totals of other passes are empty.
+    if (draws(ui)) {
+        UILayoutNode *node = layout_node(ui, layout->id);
+        node->fixed_size = layout->fixed_size;
+        node->flex_total = layout->flex_total;
+    }
+
+    pop(&window->layouts);
+}
+
+void layout_flex(UI *ui, r32 weight) {
+    UILayout *layout = current_layout(ui);
+    assert(layout);
+
+    layout->next_flex = weight;
+}
+
+UIRect layout_rect(UI *ui, V2i size) {
+    UILayout *layout = current_layout(ui);
+    assert(layout);
+
+    b32 row = layout->direction == UI_LAYOUT_ROW;
+    s32 main_size  = row ? layout->area.w : layout->area.h;
+    s32 cross_size = row ? layout->area.h : layout->area.w;
+
+    s32 main  = row ? size.w : size.h;
+    s32 cross = row ? size.h : size.w;
+
+    if (layout->next_flex > 0.0f) {
+        layout->flex_total += layout->next_flex;
+
+        // NOTE: The totals include the spacing after every element, the last one doesn't need it.
+        s32 used = layout->last.fixed_size ? layout->last.fixed_size - layout->spacing : 0;
+        s32 free = main_size - used;
+        if (free > 0 && layout->last.flex_total > 0.0f) {
+            main = (s32)(free * (layout->next_flex / layout->last.flex_total));
+        } else {
+            main = 0;
+        }
+
+        cross = cross_size;
+        layout->next_flex = 0.0f;
     } else {
-        generate_clip_task(ui, ui->viewport.region);
+        layout->fixed_size += main;
+    }
+
+    layout->fixed_size += layout->spacing;
+
+    UIRect rect = {layout->cursor.x, layout->cursor.y, row ? main : cross, row ? cross : main};
+
+    if (row) layout->cursor.x += main + layout->spacing;
+    else     layout->cursor.y += main + layout->spacing;
+
+    return rect;
+}
+
+INTERNAL V2i text_metrics(UIFont *font, String text, r32 height);
+
+// NOTE: Measuring is cached per node, text only gets measured again if it or the font changed.
+
+INTERNAL V2i measure_text(UI *ui, void *id, s32 font_id, String text, r32 height) {
+    UIFont *font = &ui->fonts[font_id];
+
+    UILayout *layout = current_layout(ui);
+    if (!layout) return text_metrics(font, text, height);
+
+    u64 h = content_hash(0x100, text.data, text.size);
+    h = content_hash(h, &font_id, sizeof(font_id));
+    h = content_hash(h, &height, sizeof(height));
+
+    s32 constraint = layout->direction == UI_LAYOUT_ROW ? layout->area.h : layout->area.w;
+
+    UILayoutNode *node = layout_node(ui, layout_key(layout->id, id));
+    if (node->content_hash != h || node->constraint != constraint) {
+        node->content_hash = h;
+        node->constraint   = constraint;
+        node->size         = text_metrics(font, text, height);
     }
+
+    return node->size;
 }
 
-void do_frame(UI *ui, V2i window_size, UserInput *input) {
+b32 do_frame(UI *ui, V2i window_size, UserInput *input) {
     assert(input);
     assert(ui->frame_func);
     assert(ui->clip_stack.size == 0);
     // TODO: Always load a default font.
     assert(ui->fonts.size > 0);
 
+    // NOTE: The tasks and quads of the last frame stay as they are.
+    if (idle_frame(ui, window_size, input)) return false;
+
+    ui->invalidated      = false;
+    ui->last_frame_size  = window_size;
+    ui->last_frame_mouse = input->mouse;
+
+    ui->frame_index += 1;
+    ui->layout_nodes_used = 0;
+
     ui->viewport.region.w = window_size.w;
     ui->viewport.region.h = window_size.h;
+    ui->clip = ui->viewport.region;
 
     ui->per_frame_memory.used = 0;
-    ui->vertex_buffer.size = 0;
 
     ui->input = input;
 
     ui->hover = hovered_element(ui);
     ui->current_window = &ui->viewport;
 
-    prepare_window(&ui->viewport);
+    keep_last_output(&ui->viewport);
+    FOR (ui->windows, window) {
+        keep_last_output(window);
+    }
 
-    {
+    prepare_windows(ui);
+
+    if (ui->single_pass) {
+        ui->input_handled = false;
+
+        ui->state = UI_STATE_INPUT_AND_DRAW;
+        ui->frame_func(ui);
+
+        if (ui->input_handled) {
+            // NOTE: The application changed while it was drawn, throw the pass away and draw again.
+            ui->current_window = &ui->viewport;
+            prepare_windows(ui);
+
+            ui->state = UI_STATE_DRAW;
+            ui->frame_func(ui);
+        }
+    } else {
         ui->state = UI_STATE_INPUT;
         ui->frame_func(ui);
 
@@ -186,33 +876,56 @@ void do_frame(UI *ui, V2i window_size, UserInput *input) {
         ui->frame_func(ui);
     }
 
+    b32 changed = finish_windows(ui);
+    prune_layout_cache(ui);
+
     if (!ui->input->mouse.keys[MOUSE_LMB]) {
         ui->last_clicked = 0;
     }
 
     ui->state = UI_STATE_IDLE;
     ui->input = 0;
+
+    return changed;
 }
 
 
 
-INTERNAL b32 size_from_layout(UI *ui, UIRect *rect) {
-    // TODO: Check if a layout is set or else just return false.
+INTERNAL b32 size_from_layout(UI *ui, UIRect *rect, V2i size) {
+    if (current_layout(ui)) {
+        *rect = layout_rect(ui, size);
+        return true;
+    }
+
     rect->x = ui->current_window->widget_cursor.x;
     rect->y = ui->current_window->widget_cursor.y;
+    rect->w = size.w;
+    rect->h = size.h;
 
     return false;
 }
 
+// NOTE: Inside a layout the widget is placed with the size already in rect.
 INTERNAL b32 widget_sizing(UI *ui, UIRect *rect, UITheme const *theme = 0) {
     UIWindow *window = ui->current_window;
     s32 margin = theme ? theme->margin : 0;
 
+    if (current_layout(ui)) {
+        UIRect cell = layout_rect(ui, {rect->w + margin * 2, rect->h + margin * 2});
+
+        rect->x = cell.x + margin;
+        rect->y = cell.y + margin;
+        rect->w = cell.w - margin * 2;
+        rect->h = cell.h - margin * 2;
+        window->next_widget_offset = {};
+
+        return true;
+    }
+
     rect->x = window->widget_cursor.x + margin + window->next_widget_offset.x;
     rect->y = window->widget_cursor.y + margin + window->next_widget_offset.y;
     window->next_widget_offset = {};
 
-    // TODO: Calculate width and height from layout.
     return false;
 }
 
@@ -224,26 +937,49 @@ INTERNAL void add_hittest(UI *ui, void *id, UIRect rect) {
     };
 
     append(&ui->current_window->hittests, hit);
+    add_to_hit_grid(ui->current_window, (s32)ui->current_window->hittests.size - 1, rect);
 }
 
-INTERNAL void append(UI *ui, UITask *task, UIVertex vertex) {
-    append(&ui->vertex_buffer, vertex);
+// NOTE: No growth check, reserve the quads of a batch with ensure_space first.
+INTERNAL void push_quad(List<UIQuad> *quads, UITask *task, UIRect clip, UIQuad quad) {
+    assert(quads->size < quads->alloc);
+    if (!clip_quad(clip, &quad)) return;
+
+    quads->data[quads->size] = quad;
+    quads->size += 1;
     task->count += 1;
 }
 
-INTERNAL void draw_rect(UI *ui, UITask *task, UIRect rect, u32 color) {
-    r32 x0 = (r32)rect.x;
-    r32 y0 = (r32)rect.y;
-    r32 x1 = x0 + rect.w;
-    r32 y1 = y0 + rect.h;
+INTERNAL void push_quad(UI *ui, UITask *task, UIQuad quad) {
+    push_quad(&ui->current_window->quads, task, ui->clip, quad);
+}
 
-    append(ui, task, {{x0, y0}, {}, color});
-    append(ui, task, {{x1, y0}, {}, color});
-    append(ui, task, {{x0, y1}, {}, color});
-               
-    append(ui, task, {{x0, y1}, {}, color});
-    append(ui, task, {{x1, y0}, {}, color});
-    append(ui, task, {{x1, y1}, {}, color});
+INTERNAL u16 to_unorm16(r32 value) {
+    if (value <= 0.0f) return 0;
+    if (value >= 1.0f) return 0xFFFF;
+
+    return (u16)(value * 65535.0f + 0.5f);
+}
+
+// NOTE: Clamped instead of wrapped, so far away quads (a long scrolled list) stay outside
+//       and get culled instead of wrapping around onto the screen.
+INTERNAL s16 to_coordinate(s64 value) {
+    if (value < -32768) return -32768;
+    if (value >  32767) return  32767;
+
+    return (s16)value;
+}
+
+INTERNAL void draw_rect(UI *ui, UITask *task, UIRect rect, u32 color) {
+    UIQuad quad = {};
+    quad.x0 = to_coordinate(rect.x);
+    quad.y0 = to_coordinate(rect.y);
+    quad.x1 = to_coordinate((s64)rect.x + rect.w);
+    quad.y1 = to_coordinate((s64)rect.y + rect.h);
+    quad.color = color;
+
+    ensure_space(&ui->current_window->quads, 1);
+    push_quad(ui, task, quad);
 }
 
 INTERNAL void draw_rect(UI *ui, UIRect rect, u32 color) {
@@ -256,19 +992,21 @@ INTERNAL void glyph_info(UIFont *font, UIGlyphInfo *info, u32 cp, r32 height) {
     font->glyph_info(font->font_data, info, cp, height);
 }
 
-INTERNAL void draw_character(UI *ui, UITask *task, UIGlyphInfo *glyph, V2i pos, r32 height, u32 color) {
-    r32 x0 = (r32)(pos.x + glyph->x0);
-    r32 y0 = (r32)(pos.y + glyph->y0);
-    r32 x1 = (r32)(pos.x + glyph->x1);
-    r32 y1 = (r32)(pos.y + glyph->y1);
+INTERNAL UIQuad glyph_quad(UIGlyphInfo *glyph, V2i pos, u32 color) {
+    UIQuad quad;
+    quad.x0 = to_coordinate((s64)pos.x + glyph->x0);
+    quad.y0 = to_coordinate((s64)pos.y + glyph->y0);
+    quad.x1 = to_coordinate((s64)pos.x + glyph->x1);
+    quad.y1 = to_coordinate((s64)pos.y + glyph->y1);
+
+    quad.u0 = to_unorm16(glyph->u0);
+    quad.v0 = to_unorm16(glyph->v0);
+    quad.u1 = to_unorm16(glyph->u1);
+    quad.v1 = to_unorm16(glyph->v1);
 
-    append(ui, task, {{x0, y0}, {glyph->u0, glyph->v0}, color});
-    append(ui, task, {{x1, y0}, {glyph->u1, glyph->v0}, color});
-    append(ui, task, {{x0, y1}, {glyph->u0, glyph->v1}, color});
+    quad.color = color;
 
-    append(ui, task, {{x0, y1}, {glyph->u0, glyph->v1}, color});
-    append(ui, task, {{x1, y0}, {glyph->u1, glyph->v0}, color});
-    append(ui, task, {{x1, y1}, {glyph->u1, glyph->v1}, color});
+    return quad;
 }
 
 INTERNAL V2i text_metrics(UIFont *font, String text, r32 height) {
@@ -276,34 +1014,140 @@ INTERNAL V2i text_metrics(UIFont *font, String text, r32 height) {
     return font->text_metrics(font->font_data, text, height);
 }
 
+//===============================================
+// Labels don't need anything back from their
+// glyphs, so draw_text only records a command and
+// the glyphs are generated when the window is
+// finished, possibly on another thread. The text
+// is copied into the text_bytes of the window,
+// which grow with the labels of the frame.
+//===============================================
+struct UITextCommand {
+    s64 task;
+    s32 font_id;
+
+    UIRect rect;
+    UIRect clip;
+    r32 height;
+    s64 text_start; // NOTE: Into UIWindow::text_bytes, the list moves when it grows.
+    s64 text_length;
+    u32 color;
+
+    UITextAlign align;
+    b32 has_size;
+    V2i text_size;
+};
+
 // TODO: Additional selectable text function.
-INTERNAL void draw_text(UI *ui, s32 font_id, UIRect rect, r32 height, String text, u32 color, UITextAlign align = UI_TEXT_ALIGN_LEFT) {
-    UITask *task = create_new_task(ui, UI_TASK_TEXT);
+// NOTE: Pass the size of the text if it was measured already, centering needs it.
+INTERNAL void draw_text(UI *ui, s32 font_id, UIRect rect, r32 height, String text, u32 color, UITextAlign align = UI_TEXT_ALIGN_LEFT, V2i const *text_size = 0) {
+    UIWindow *window = ui->current_window;
 
-    UIFont *font = &ui->fonts[font_id];
+    UITextCommand command = {};
+    command.font_id = font_id;
+    command.rect    = rect;
+    command.clip    = ui->clip;
+    command.height  = height;
+    command.color   = color;
+    command.align   = align;
+
+    if (text_size) {
+        command.has_size  = true;
+        command.text_size = *text_size;
+    }
+
+    // NOTE: Commands right after each other generate their glyphs right after each other, they can share a task.
+    UITask *last = window->tasks.size ? &window->tasks[-1] : 0;
+    b32 continues = window->text_commands.size && window->text_commands[-1].task == window->tasks.size - 1 && last->text.font_id == font_id;
+
+    if (!continues) {
+        UITask task = {};
+        task.kind         = UI_TASK_TEXT;
+        task.start        = -1;
+        task.text.font_id = font_id;
+        append(&window->tasks, task);
+    }
+
+    command.task        = window->tasks.size - 1;
+    command.text_start  = window->text_bytes.size;
+    command.text_length = text.size;
+    append(&window->text_bytes, Array<u8>{text.data, text.size});
+    append(&window->text_commands, command);
+}
+
+INTERNAL void generate_text(UI *ui, UIWindow *window) {
+    FOR (window->text_commands, command) {
+        UITask *task = &window->tasks[command->task];
+        if (task->start == -1) task->start = window->quads.size;
+
+        UIFont *font = &ui->fonts[command->font_id];
+        String text(window->text_bytes.data + command->text_start, command->text_length);
+
+        V2i cursor = {command->rect.x, command->rect.y};
+        if (command->align == UI_TEXT_ALIGN_CENTER) {
+            V2i metrics = command->has_size ? command->text_size : text_metrics(font, text, command->height);
 
-    V2i cursor = {rect.x, rect.y};
-    if (align == UI_TEXT_ALIGN_CENTER) {
-        V2i metrics = text_metrics(font, text, height);
+            cursor.x = (command->rect.x + (command->rect.w / 2)) - (metrics.w / 2);
+            cursor.y = (command->rect.y + (command->rect.h / 2)) - (metrics.h / 2);
+        }
+
+        UIGlyphInfo glyph = {};
+        u32 codepoints[UTF8DecodeBlockSize];
+        while (text.size) {
+            UTF8DecodeResult block = decode_utf8_block(text, codepoints, UTF8DecodeBlockSize);
+            ensure_space(&window->quads, block.count);
 
-        s32 x_offset = (rect.x + (rect.w / 2)) - (metrics.w / 2);
-        s32 y_offset = (rect.y + (rect.h / 2)) - (metrics.h / 2);
+            for (s64 i = 0; i < block.count; i += 1) {
+                glyph_info(font, &glyph, codepoints[i], command->height);
+                push_quad(&window->quads, task, command->clip, glyph_quad(&glyph, cursor, command->color));
 
-        cursor.x = x_offset;
-        cursor.y = y_offset;
+                cursor.x += glyph.advance;
+            }
+
+            if (block.status != UTF_OK) break;
+            text = shrink_front(text, block.bytes);
+        }
     }
+}
+
+// NOTE: Over everything the window recorded this frame, before text and batching.
+//       Equal recordings finish into equal output, see finish_window.
+INTERNAL u64 recorded_hash(UIWindow *window) {
+    u64 h = 0x100;
+
+    FOR (window->tasks, task) {
+        h = content_hash(h, &task->kind, sizeof(task->kind));
+        h = content_hash(h, &task->start, sizeof(task->start));
+        h = content_hash(h, &task->count, sizeof(task->count));
+        h = content_hash(h, &task->underlay, sizeof(task->underlay));
 
-    UIGlyphInfo glyph = {};
-    for (auto it = make_utf8_it(text); it.valid; next(&it)) {
-        glyph_info(font, &glyph, it.cp, height);
-        draw_character(ui, task, &glyph, cursor, height, color);
+        if (task->kind == UI_TASK_CLIPPING) h = content_hash(h, &task->clipping.area, sizeof(task->clipping.area));
+        if (task->kind == UI_TASK_TEXT)     h = content_hash(h, &task->text.font_id, sizeof(task->text.font_id));
+    }
 
-        cursor.x += glyph.advance;
+    h = content_hash(h, window->quads.data, window->quads.size * sizeof(UIQuad));
+
+    FOR (window->text_commands, command) {
+        h = content_hash(h, &command->task, sizeof(command->task));
+        h = content_hash(h, &command->font_id, sizeof(command->font_id));
+        h = content_hash(h, &command->rect, sizeof(command->rect));
+        h = content_hash(h, &command->clip, sizeof(command->clip));
+        h = content_hash(h, &command->height, sizeof(command->height));
+        h = content_hash(h, &command->color, sizeof(command->color));
+        h = content_hash(h, &command->align, sizeof(command->align));
+        h = content_hash(h, &command->has_size, sizeof(command->has_size));
+        h = content_hash(h, &command->text_size, sizeof(command->text_size));
+        h = content_hash(h, &command->text_start, sizeof(command->text_start));
+        h = content_hash(h, &command->text_length, sizeof(command->text_length));
     }
+
+    h = content_hash(h, window->text_bytes.data, window->text_bytes.size);
+
+    return h;
 }
 
 void text_line(UI *ui, s32 font, r32 height, String text, u32 color) {
-    if (ui->state == UI_STATE_DRAW) {
+    if (draws(ui)) {
         UIRect rect = {
             ui->current_window->widget_cursor.x,
             ui->current_window->widget_cursor.y,
@@ -320,8 +1164,9 @@ void text_line(UI *ui, s32 font, r32 height, String text, u32 color) {
 }
 
 s32 edit_line(UI *ui, UIFontStyle font, String text, s32 indent, s32 cursor) {
-    if (ui->state == UI_STATE_DRAW) {
+    if (draws(ui)) {
         UIRect rect = {};
+        rect.h = (s32)font.height;
         if (!widget_sizing(ui, &rect)) {
             ui->current_window->widget_cursor.y += (s32)font.height;
         }
@@ -351,21 +1196,25 @@ b32 button(UI *ui, void *id, String text, UITheme *custom_theme) {
     b32 clicked = false;
 
     ButtonState state = click_info(ui, id);
-    if (ui->state == UI_STATE_DRAW) {
+    if (draws(ui)) {
         UITheme const *theme = &ButtonTheme;
         if (custom_theme) theme = custom_theme;
 
+        V2i text_size = measure_text(ui, id, theme->font_id, text, theme->font_height);
+
+        V2i size = text_size;
+        size.w += theme->padding + theme->margin * 2;
+        size.h += theme->padding + theme->margin * 2;
+
         UIRect rect = {};
-        if (!size_from_layout(ui, &rect)) {
-            // TODO: Size is calculated later in rendering again. Maybe cache it somehow?
-            UIFont *font = &ui->fonts[theme->font_id];
-            V2i text_size = font->text_metrics(font->font_data, text, theme->font_height);
-            rect.w = text_size.w + theme->padding;
-            rect.h = text_size.h + theme->padding;
-        }
+        size_from_layout(ui, &rect, size);
 
         rect.x += theme->margin;
         rect.y += theme->margin;
+        rect.w -= theme->margin * 2;
+        rect.h -= theme->margin * 2;
+        if (rect.w < 0) rect.w = 0;
+        if (rect.h < 0) rect.h = 0;
 
         add_hittest(ui, id, rect);
 
@@ -374,10 +1223,13 @@ b32 button(UI *ui, void *id, String text, UITheme *custom_theme) {
         if (state == BUTTON_PRESSED) color = theme->pressed;
         draw_rect(ui, rect, color);
 
-        draw_text(ui, theme->font_id, rect, theme->font_height, text, theme->font_color, UI_TEXT_ALIGN_CENTER);
-    } else if (ui->state == UI_STATE_INPUT) {
+        draw_text(ui, theme->font_id, rect, theme->font_height, text, theme->font_color, UI_TEXT_ALIGN_CENTER, &text_size);
+    }
+
+    if (handles_input(ui)) {
         if (state == BUTTON_ACTIVATE) {
             clicked = true;
+            ui->input_handled = true;
         }
     }
 
@@ -400,7 +1252,7 @@ b32 begin_custom_region(UI *ui, UIRect region, u32 background) {
     window->widget_cursor.x = region.x;
     window->widget_cursor.y = region.y;
 
-    if (ui->state == UI_STATE_DRAW && background) {
+    if (draws(ui) && background) {
         draw_rect(ui, region, background);
     }
 
@@ -432,12 +1284,16 @@ void offset_widgets(UI *ui, V2i offset) {
 s32 capture_scroll(UI *ui, void *id, UIRect region) {
     s32 scroll = 0;
 
-    if (ui->state == UI_STATE_INPUT) {
+    // NOTE: With two passes the hittest goes in with the input pass, below the ones the drawing pass adds.
+    //       A single pass frame rebuilds the hittests in its second pass, so it is added whenever drawing.
+    b32 adds_hittest = ui->single_pass ? draws(ui) : ui->state == UI_STATE_INPUT;
+    if (adds_hittest) {
         add_hittest(ui, id, region);
+    }
 
-        if (ui->hover == id) {
-            scroll = ui->input->mouse.scroll;
-        }
+    if (handles_input(ui) && ui->hover == id) {
+        scroll = ui->input->mouse.scroll;
+        if (scroll) ui->input_handled = true;
     }
 
     return scroll;
@@ -465,10 +1321,12 @@ b32 begin_text_edit_region(UI *ui, UIRect region, UICustomKeyCallback *callback)
 
     push_clipping(ui, region);
 
-    if (ui->state == UI_STATE_INPUT && callback) {
+    if (handles_input(ui) && callback) {
         for (s32 i = 0; i < ui->input->actions.used; i += 1) {
             callback(&ui->input->actions.keys[i]);
         }
+
+        if (ui->input->actions.used) ui->input_handled = true;
     }
 
     return open;
@@ -491,13 +1349,17 @@ s32 text_piece(UI *ui, String text, UIFontStyle style, u8 *cursor_pos) {
     // TODO: The hover calculation should actually happen in the input state.
     //       But that means the string would be processed twice per frame
     //       and I think that is unnecesarry.
-    if (ui->state == UI_STATE_DRAW) {
-        UITask *task = create_new_task(ui, UI_TASK_TEXT);
+    if (draws(ui)) {
+        UIRect rect = {};
+        widget_sizing(ui, &rect);
+
+        // NOTE: Lines scrolled out of the clip area are skipped before any glyph lookups.
+        if (!overlaps_clip(ui, rect.y, (s32)style.height)) return hovered_character;
+
+        UITask *task = create_new_task(ui, UI_TASK_TEXT, style.id);
 
         UIFont *font = &ui->fonts[style.id];
 
-        UIRect rect = {};
-        widget_sizing(ui, &rect);
         V2i cursor = {rect.x, rect.y};
 
         Point pointer = ui->input->mouse.cursor_pos;
@@ -508,25 +1370,38 @@ s32 text_piece(UI *ui, String text, UIFontStyle style, u8 *cursor_pos) {
 
         s32 i = 0;
         UIGlyphInfo glyph = {};
-        for (auto it = make_utf8_it(text); it.valid; next(&it)) {
-            glyph_info(font, &glyph, it.cp, style.height);
-
-            if (&text[it.index] == cursor_pos) {
-                draw_cursor = true;
-                cursor_bg   = cursor;
-                cursor_width = glyph.advance;
-                draw_character(ui, task, &glyph, cursor, style.height, PACK_RGB(15, 15, 15));
-            } else {
-                draw_character(ui, task, &glyph, cursor, style.height, style.fg);
+        u32 codepoints[UTF8DecodeBlockSize];
+
+        u8 *pos = begin(text);
+        String rest = text;
+        while (rest.size) {
+            UTF8DecodeResult block = decode_utf8_block(rest, codepoints, UTF8DecodeBlockSize);
+            ensure_space(&ui->current_window->quads, block.count);
+
+            for (s64 j = 0; j < block.count; j += 1) {
+                glyph_info(font, &glyph, codepoints[j], style.height);
+
+                if (pos == cursor_pos) {
+                    draw_cursor = true;
+                    cursor_bg   = cursor;
+                    cursor_width = glyph.advance;
+                    push_quad(ui, task, glyph_quad(&glyph, cursor, PACK_RGB(15, 15, 15)));
+                } else {
+                    push_quad(ui, task, glyph_quad(&glyph, cursor, style.fg));
+                }
+
+                s32 new_x = cursor.x + glyph.advance;
+                if (cursor.x < pointer.x && new_x >= pointer.x) {
+                    hovered_character = i;
+                }
+
+                cursor.x = new_x;
+                pos = next_utf8_sequence(text, pos);
+                i += 1;
             }
 
-            s32 new_x = cursor.x + glyph.advance;
-            if (cursor.x < pointer.x && new_x >= pointer.x) {
-                hovered_character = i;
-            }
-
-            cursor.x = new_x;
-            i += 1;
+            if (block.status != UTF_OK) break;
+            rest = shrink_front(rest, block.bytes);
         }
 
         if (end(text) == cursor_pos) {
@@ -538,7 +1413,7 @@ s32 text_piece(UI *ui, String text, UIFontStyle style, u8 *cursor_pos) {
 
         if (draw_cursor) {
             UIRect  cursor_quad = {cursor_bg.x, cursor_bg.y, cursor_width, (s32)style.height};
-            UITask *cursor_task = create_new_task_before(ui, UI_TASK_GEOMETRY);
+            UITask *cursor_task = create_underlay_task(ui, UI_TASK_GEOMETRY);
 
             u32 color = DefaultCursor.color;
             if (color == 0) color = style.fg;
@@ -555,6 +1430,28 @@ s32 text_piece(UI *ui, String text, UIFontStyle style, u8 *cursor_pos) {
     return hovered_character;
 }
 
+s32 text_piece(UI *ui, TextBuffer *buffer, s64 line, UIFontStyle style, s64 cursor_pos) {
+    if (!draws(ui)) return -1;
+
+    s64 start = line_start(buffer, line);
+    s64 end   = line_end(buffer, line);
+
+    // NOTE: Empty lines still need a valid pointer, a null cursor means no cursor.
+    u8 empty = 0;
+    String text = line_text(buffer, line);
+    if (text.data == 0) text.data = &empty;
+
+    u8 *cursor = 0;
+    if (cursor_pos >= start && cursor_pos <= end) {
+        s64 offset = cursor_pos - start;
+        if (offset > text.size) offset = text.size; // NOTE: Past a stripped \r.
+
+        cursor = text.data + offset;
+    }
+
+    return text_piece(ui, text, style, cursor);
+}
+
 b32 advance_text_line(UI *ui, s32 line_height) {
     b32 keep_advancing = false;
 
@@ -570,3 +1467,119 @@ b32 advance_text_line(UI *ui, s32 line_height) {
 
     return keep_advancing;
 }
+
+UILineRange visible_lines(UI *ui, s64 line_count, s32 line_height, s32 scroll) {
+    UIWindow *window = ui->current_window;
+    assert(window->region_kind == UI_REGION_TEXT);
+    assert(line_height > 0);
+
+    UIRect region = window->user_region.region;
+
+    UILineRange range = {};
+    range.first = scroll / line_height;
+    range.y     = region.y - (scroll % line_height);
+
+    s64 visible = (region.y + region.h - range.y + line_height - 1) / line_height;
+    range.end = range.first + visible;
+
+    if (range.first > line_count) range.first = line_count;
+    if (range.end > line_count)   range.end   = line_count;
+
+    return range;
+}
+
+INTERNAL s32 const UITextScrollLines = 3;
+
+UILineRange text_lines(UI *ui, void *id, s64 line_count, s32 line_height, s32 *scroll, UITextLineCallback *callback, void *data) {
+    UIWindow *window = ui->current_window;
+    assert(window->region_kind == UI_REGION_TEXT);
+
+    UIRect region = window->user_region.region;
+
+    // NOTE: Wheel up is positive and moves towards the start of the text.
+    //       The scroll is applied before any line is drawn, no second pass needed.
+    b32 input_handled = ui->input_handled;
+    s32 wheel = capture_scroll(ui, id, region);
+    ui->input_handled = input_handled;
+
+    s64 max_scroll = line_count * line_height - region.h;
+    if (max_scroll < 0) max_scroll = 0;
+
+    s64 new_scroll = *scroll - (s64)wheel * line_height * UITextScrollLines;
+    if (new_scroll > max_scroll) new_scroll = max_scroll;
+    if (new_scroll < 0)          new_scroll = 0;
+    *scroll = (s32)new_scroll;
+
+    UILineRange range = visible_lines(ui, line_count, line_height, *scroll);
+
+    window->widget_cursor.x = window->reset.x;
+    window->widget_cursor.y = range.y;
+
+    for (s64 line = range.first; line < range.end; line += 1) {
+        callback(ui, data, line);
+
+        window->widget_cursor.x  = window->reset.x;
+        window->widget_cursor.y += line_height;
+    }
+
+    return range;
+}
+
+
+char const *const UIQuadVertexShader = R"(
+#version 330 core
+
+layout(location = 0) in vec4 rect;
+layout(location = 1) in vec4 uv;
+layout(location = 2) in vec4 color;
+
+uniform mat4 projection;
+
+out vec2 frag_uv;
+out vec4 frag_color;
+
+void main() {
+    // NOTE: Triangle strip corners, 0 top left, 1 top right, 2 bottom left, 3 bottom right.
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+
+    gl_Position = projection * vec4(mix(rect.xy, rect.zw, corner), 0.0, 1.0);
+    frag_uv     = mix(uv.xy, uv.zw, corner);
+    frag_color  = color;
+}
+)";
+
+void expand_quads(Array<UIQuad> quads, UIVertex *out) {
+    r32 const uv_factor = 1.0f / 65535.0f;
+
+    FOR (quads, quad) {
+        r32 x0 = quad->x0;
+        r32 y0 = quad->y0;
+        r32 x1 = quad->x1;
+        r32 y1 = quad->y1;
+
+        r32 u0 = quad->u0 * uv_factor;
+        r32 v0 = quad->v0 * uv_factor;
+        r32 u1 = quad->u1 * uv_factor;
+        r32 v1 = quad->v1 * uv_factor;
+
+        out[0] = {{x0, y0}, {u0, v0}, quad->color};
+        out[1] = {{x1, y0}, {u1, v0}, quad->color};
+        out[2] = {{x0, y1}, {u0, v1}, quad->color};
+        out[3] = {{x1, y1}, {u1, v1}, quad->color};
+        out += 4;
+    }
+}
+
+void quad_indices(u32 *out, s64 quad_count) {
+    for (s64 i = 0; i < quad_count; i += 1) {
+        u32 base = (u32)(i * 4);
+
+        out[0] = base + 0;
+        out[1] = base + 1;
+        out[2] = base + 2;
+        out[3] = base + 2;
+        out[4] = base + 1;
+        out[5] = base + 3;
+        out += 6;
+    }
+}
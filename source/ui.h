@@ -5,13 +5,37 @@
 #include "list.h"
 #include "arena.h"
 #include "vector.h"
+#include "hash_table.h"
 
 #include "ui_theme.h"
+#include "text_buffer.h"
 
 
 struct UI;
 
 struct UIHittest;
+struct UIBatch;
+struct UITextCommand;
+
+//===============================================
+// Every rect and glyph is a single UIQuad, the
+// tasks count quads. Backends with instancing draw
+// one instance per quad, UIQuadVertexShader builds
+// the corners from gl_VertexID:
+//
+//   attribute 0: x0 y0 x1 y1, GL_SHORT
+//   attribute 1: u0 v0 u1 v1, GL_UNSIGNED_SHORT normalized
+//   attribute 2: color,       GL_UNSIGNED_BYTE normalized
+//   glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count)
+//
+// Others expand the quads into four UIVertex each
+// and draw them with the shared quad_indices.
+//===============================================
+struct UIQuad {
+    s16 x0, y0, x1, y1;
+    u16 u0, v0, u1, v1; // NOTE: 0..65535 maps to 0..1.
+    u32 color;
+};
 
 struct UIVertex {
     V3  pos;
@@ -19,6 +43,13 @@ struct UIVertex {
     u32 color;
 };
 
+extern char const *const UIQuadVertexShader;
+
+// NOTE: Writes 4 vertices per quad in the order top left, top right, bottom left, bottom right.
+void expand_quads(Array<UIQuad> quads, UIVertex *out);
+// NOTE: Writes 6 indices per quad, the same for every frame so they can be uploaded once.
+void quad_indices(u32 *out, s64 quad_count);
+
 struct UIRect {
     s32 x, y, w, h;
 };
@@ -36,6 +67,8 @@ struct UIFont {
     void *font_data;
     UITextMetricCallback *text_metrics;
     UIGlyphInfoCallback  *glyph_info;
+
+    b32 thread_safe; // NOTE: The callbacks may run on multiple threads at once, see UI::parallel_for.
 };
 
 struct UIFontStyle {
@@ -51,7 +84,7 @@ enum UITextAlign {
 
 enum UITaskKind {
     UI_TASK_EMPTY,
-    UI_TASK_CLIPPING,
+    UI_TASK_CLIPPING, // NOTE: Only with UI_GPU_CLIPPING defined.
     UI_TASK_GEOMETRY,
     UI_TASK_TEXT,
 };
@@ -60,6 +93,8 @@ struct UITask {
     s64 start;
     s64 count;
 
+    b32 underlay; // NOTE: Drawn below the task before it, batching puts it in front.
+
     union {
         struct {
             s32 font_id;
@@ -83,6 +118,73 @@ struct UIUserRegion {
     UIRect region;
 };
 
+//===============================================
+// Hittests are sorted into a uniform grid while
+// they are added. Every cell lists its hittests
+// newest first, so the first one containing the
+// cursor is the top most and hover detection only
+// looks at a single cell.
+//===============================================
+struct UIHitNode {
+    s32 hittest;
+    s32 next;
+};
+
+struct UIHitGrid {
+    V2i origin;
+    s32 columns;
+    s32 rows;
+
+    List<s32> cells; // NOTE: First node of every cell, -1 if empty.
+    List<UIHitNode> nodes;
+};
+
+//===============================================
+// Layouts place the widgets inside them along a
+// row or a column. Widgets with a flex weight
+// share the space the fixed sized ones leave.
+// A share depends on all siblings, so it uses the
+// sizes of the last frame and a changed layout
+// settles one frame later.
+//
+// Every widget measured inside a layout is a node
+// of the layout cache, keyed by its id and the
+// layout. A node whose content and constraint are
+// unchanged reuses its size instead of measuring
+// the text again. Nodes not used for a while are
+// dropped.
+//===============================================
+enum UILayoutDirection {
+    UI_LAYOUT_ROW,
+    UI_LAYOUT_COLUMN,
+};
+
+struct UILayoutNode {
+    u64 content_hash;
+    s32 constraint; // NOTE: Cross axis size of the layout the node was measured in.
+    V2i size;
+
+    // NOTE: Only for layouts, the totals of the last frame.
+    s32 fixed_size;
+    r32 flex_total;
+
+    u64 frame; // NOTE: Last frame the node was used.
+};
+
+struct UILayout {
+    u64 id;
+    UILayoutDirection direction;
+    UIRect area;
+    s32 spacing;
+
+    V2i cursor;
+    s32 fixed_size;
+    r32 flex_total;
+    r32 next_flex;
+
+    UILayoutNode last; // NOTE: The totals of the last frame.
+};
+
 struct UIWindow {
     void *id;
     UIRect region;
@@ -91,18 +193,50 @@ struct UIWindow {
     V2i reset;
     List<UITask> tasks;
     List<UIHittest> hittests;
+    UIHitGrid hit_grid;
 
     UIRegionKind region_kind;
     UIUserRegion user_region;
 
     V2i next_widget_offset;
+
+    List<UILayout> layouts;
+
+    // NOTE: Every window records into its own buffers, everything at the end of the
+    //       frame only touches one window and the windows are finished in parallel.
+    List<UIQuad> quads;
+    List<UIQuad> batch_quads;
+    List<UIBatch> batches;
+    List<s32>     batch_parts;
+    List<UITextCommand> text_commands;
+    List<u8> text_bytes;
+
+    // NOTE: Where the quads of the window ended up in UI::quad_buffer. A renderer keeping
+    //       a copy per window only needs to upload them again if changed is set.
+    s64 quad_start;
+    s64 quad_count;
+    u64 content_hash;
+    b32 changed;
+
+    // NOTE: The finished output of the last frame. A window that records exactly the same
+    //       tasks, quads and text again takes it over and skips generating text and batching.
+    //       Glyphs are not part of the recording, a font whose glyphs change needs a new font_id.
+    List<UITask> last_tasks;
+    List<UIQuad> last_quads;
+    u64 recorded_hash;
+    b32 finished;
 };
 
 typedef void UIFrameFunc(UI *ui);
+
+// NOTE: Has to run job for every index below count and only return once all of them are done.
+typedef void UIParallelJob(void *context, s64 index);
+typedef void UIParallelFunc(void *data, s64 count, UIParallelJob *job, void *context);
 enum UIState {
     UI_STATE_IDLE,
     UI_STATE_INPUT,
     UI_STATE_DRAW,
+    UI_STATE_INPUT_AND_DRAW, // NOTE: Single pass frames, see UI::single_pass.
 };
 struct UI {
     UIState state;
@@ -114,6 +248,13 @@ struct UI {
     void *active;
     void *last_clicked;
 
+    // NOTE: With single_pass set, the frame function runs once per frame and widgets
+    //       handle input and draw at the same time, hover is based on the hittests of
+    //       the last frame. Only if a widget reports input back to the application a
+    //       second drawing pass runs, so the frame shows the changed state.
+    b32 single_pass;
+    b32 input_handled;
+
     MemoryArena per_frame_memory;
 
     UIWindow  viewport;
@@ -122,26 +263,70 @@ struct UI {
 
     List<UIFont> fonts;
     List<UIRect> clip_stack;
+    UIRect clip;
 
     UIFrameFunc *frame_func;
 
-    List<UIVertex> vertex_buffer;
+    List<UIQuad> quad_buffer; // NOTE: The quads of all windows one after another, task starts index into it.
+
+    // NOTE: The windows are finished with parallel_for if it is set, which includes
+    //       generating the glyphs of labels and buttons. As long as one of the fonts
+    //       isn't marked thread_safe they are finished one after another instead.
+    UIParallelFunc *parallel_for;
+    void *parallel_data;
+
+    // NOTE: With skip_idle_frames set, a frame without new input doesn't run the frame
+    //       function at all when the last frame didn't change anything. The application
+    //       has to call invalidate when its state changes outside of the input then.
+    b32 skip_idle_frames;
+    b32 invalidated;
+
+    UserMouseInput last_frame_mouse;
+    V2i last_frame_size;
+
+    HashTable<u64, UILayoutNode> layout_cache;
+    s64 layout_nodes_used; // NOTE: In the current frame, to know when to drop old nodes.
+    u64 frame_index;
+
+    // NOTE: The containers of the UI and its viewport allocate from allocator through the UI,
+    //       which counts every allocation. They point back to the UI, so it must not be moved
+    //       after init. The per frame arena is allocated once at init and not counted.
+    Allocator allocator;
+    s64 volatile allocations;
+    s64 volatile allocated_bytes;
 };
 
+inline b32 handles_input(UI *ui) {
+    return ui->state == UI_STATE_INPUT || ui->state == UI_STATE_INPUT_AND_DRAW;
+}
+
+inline b32 draws(UI *ui) {
+    return ui->state == UI_STATE_DRAW || ui->state == UI_STATE_INPUT_AND_DRAW;
+}
+
 inline r32 pt(r32 points) {
     r32 const factor = 1.0f / 0.75f;
     return points * factor;
 }
 
-void init(UI *ui, s64 memory, UIFrameFunc *initial_frame);
+void init(UI *ui, s64 memory, UIFrameFunc *initial_frame, Allocator alloc = DefaultAllocator);
 
 s32 add_font(UI *ui, UIFont font);
 
-void do_frame(UI *ui, V2i window_size, UserInput *input);
+// NOTE: Returns false if the frame looks exactly like the last one and doesn't need to be presented.
+b32  do_frame(UI *ui, V2i window_size, UserInput *input);
+void invalidate(UI *ui);
 
 void text_line(UI *ui, s32 font, r32 height, String text, u32 color);
 s32  edit_line(UI *ui, UIFontStyle font, String text, s32 indent, s32 cursor);
 
+void begin_layout(UI *ui, void *id, UILayoutDirection direction, UIRect area, s32 spacing = 0);
+void end_layout(UI *ui);
+// NOTE: The next widget takes this share of the free space along the layout direction.
+void layout_flex(UI *ui, r32 weight);
+// NOTE: Places an element of the given size in the current layout, for custom widgets and nested layouts.
+UIRect layout_rect(UI *ui, V2i size);
+
 b32 button(UI *ui, String text, UITheme *custom_theme = 0);
 b32 button(UI *ui, void *id, String text, UITheme *custom_theme = 0);
 
@@ -152,8 +337,30 @@ void end_custom_region(UI *ui);
 b32  begin_text_edit_region(UI *ui, UIRect region, UICustomKeyCallback *callback);
 void end_text_edit_region(UI *ui);
 s32  text_piece(UI *ui, String text, UIFontStyle style, u8 *cursor_pos = 0);
+// NOTE: Draws one line of the buffer, cursor_pos is a position in the buffer or -1.
+s32  text_piece(UI *ui, TextBuffer *buffer, s64 line, UIFontStyle style, s64 cursor_pos = -1);
 b32  advance_text_line(UI *ui, s32 line_height);
 
+//===============================================
+// Virtualized text for a text edit region. Only
+// the lines inside the region are handed to the
+// callback, with the widget cursor set to the
+// start of the line. The callback draws the line
+// (text_piece) and must not advance the line.
+// scroll is in pixels from the top of the text
+// and is owned by the caller, the mouse wheel
+// over the region changes it.
+//===============================================
+struct UILineRange {
+    s64 first;
+    s64 end; // NOTE: One past the last visible line.
+    s32 y;   // NOTE: Top of the first line, above the region if it is partly scrolled out.
+};
+
+typedef void UITextLineCallback(UI *ui, void *data, s64 line);
+UILineRange visible_lines(UI *ui, s64 line_count, s32 line_height, s32 scroll);
+UILineRange text_lines(UI *ui, void *id, s64 line_count, s32 line_height, s32 *scroll, UITextLineCallback *callback, void *data);
+
 void offset_next_widget(UI *ui, V2i offset);
 void offset_widgets(UI *ui, V2i offset);
 s32  capture_scroll(UI *ui, void *id, UIRect region);
@@ -0,0 +1,385 @@
+#include "ui_raster.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UI_RASTER_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+
+struct UIRasterTask {
+    UITaskKind kind;
+    s32 font_id;
+    UIRect clip;
+};
+
+struct UIRasterItem {
+    s32 task;
+    s32 quad;
+};
+
+void init(UIFramebuffer *framebuffer, s32 width, s32 height, Allocator alloc) {
+    INIT_STRUCT(framebuffer);
+    framebuffer->allocator = alloc;
+
+    resize(framebuffer, width, height);
+}
+
+void destroy(UIFramebuffer *framebuffer) {
+    if (framebuffer->pixels) DEALLOC(framebuffer->allocator, framebuffer->pixels, (s64)framebuffer->width * framebuffer->height);
+
+    framebuffer->pixels = 0;
+    framebuffer->width  = 0;
+    framebuffer->height = 0;
+}
+
+void resize(UIFramebuffer *framebuffer, s32 width, s32 height) {
+    if (width == framebuffer->width && height == framebuffer->height) return;
+
+    destroy(framebuffer);
+    if (width <= 0 || height <= 0) return;
+
+    framebuffer->pixels = ALLOC(framebuffer->allocator, u32, (s64)width * height);
+    framebuffer->width  = width;
+    framebuffer->height = height;
+}
+
+void init(UIRasterizer *raster, Allocator alloc) {
+    INIT_STRUCT(raster);
+
+    init(&raster->atlases, 0, alloc);
+    init(&raster->tasks, 0, alloc);
+    init(&raster->items, 0, alloc);
+    init(&raster->tile_offsets, 0, alloc);
+    init(&raster->tile_fill, 0, alloc);
+}
+
+void destroy(UIRasterizer *raster) {
+    destroy(&raster->atlases);
+    destroy(&raster->tasks);
+    destroy(&raster->items);
+    destroy(&raster->tile_offsets);
+    destroy(&raster->tile_fill);
+}
+
+void set_atlas(UIRasterizer *raster, s32 font_id, UIRasterAtlas atlas) {
+    assert(font_id >= 0);
+
+    while (raster->atlases.size <= font_id) {
+        UIRasterAtlas none = {};
+        append(&raster->atlases, none);
+    }
+
+    if (atlas.edge == 0)  atlas.edge  = UIRasterDefaultEdge;
+    if (atlas.scale == 0) atlas.scale = UIRasterDefaultScale;
+
+    raster->atlases[font_id] = atlas;
+}
+
+
+//===============================================
+// Blending uses the same integer math in the SSE2
+// and the scalar path, so a pixel comes out the
+// same no matter which path drew it:
+//
+//   out = (dst * (255 - a) + src * a + 128) / 255
+//
+// with the division done as (x + (x >> 8)) >> 8.
+// The alpha channel blends towards 255 so drawing
+// on a transparent framebuffer makes it opaque.
+//===============================================
+INTERNAL u32 blend_channel(u32 dst, u32 src_term, u32 inverse) {
+    u32 x = dst * inverse + src_term;
+
+    return (x + (x >> 8)) >> 8;
+}
+
+INTERNAL u32 blend_pixel(u32 dst, u32 color, u32 alpha) {
+    u32 inverse = 255 - alpha;
+
+    u32 r = blend_channel( dst        & 0xFF, ( color        & 0xFF) * alpha + 128, inverse);
+    u32 g = blend_channel((dst >> 8)  & 0xFF, ((color >> 8)  & 0xFF) * alpha + 128, inverse);
+    u32 b = blend_channel((dst >> 16) & 0xFF, ((color >> 16) & 0xFF) * alpha + 128, inverse);
+    u32 a = blend_channel( dst >> 24,         255 * alpha + 128,                    inverse);
+
+    return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+INTERNAL void fill_span(u32 *span, s32 count, u32 color) {
+    s32 i = 0;
+#ifdef UI_RASTER_USE_SSE2
+    __m128i pixels = _mm_set1_epi32((int)color);
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128((__m128i*)(span + i), pixels);
+    }
+#endif
+    for (; i < count; i += 1) {
+        span[i] = color;
+    }
+}
+
+INTERNAL void blend_span(u32 *span, s32 count, u32 color) {
+    u32 alpha = color >> 24;
+
+    s32 i = 0;
+#ifdef UI_RASTER_USE_SSE2
+    // NOTE: Two pixels per half, every channel widened to 16 bit.
+    __m128i zero    = _mm_setzero_si128();
+    __m128i inverse = _mm_set1_epi16((short)(255 - alpha));
+    __m128i src_term = _mm_setr_epi16(
+        (short)(( color        & 0xFF) * alpha + 128),
+        (short)(((color >> 8)  & 0xFF) * alpha + 128),
+        (short)(((color >> 16) & 0xFF) * alpha + 128),
+        (short)(255 * alpha + 128),
+        (short)(( color        & 0xFF) * alpha + 128),
+        (short)(((color >> 8)  & 0xFF) * alpha + 128),
+        (short)(((color >> 16) & 0xFF) * alpha + 128),
+        (short)(255 * alpha + 128));
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i dst = _mm_loadu_si128((__m128i const*)(span + i));
+
+        __m128i low  = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(dst, zero), inverse), src_term);
+        __m128i high = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(dst, zero), inverse), src_term);
+
+        low  = _mm_srli_epi16(_mm_add_epi16(low,  _mm_srli_epi16(low,  8)), 8);
+        high = _mm_srli_epi16(_mm_add_epi16(high, _mm_srli_epi16(high, 8)), 8);
+
+        _mm_storeu_si128((__m128i*)(span + i), _mm_packus_epi16(low, high));
+    }
+#endif
+    for (; i < count; i += 1) {
+        span[i] = blend_pixel(span[i], color, alpha);
+    }
+}
+
+INTERNAL void draw_rect(UIFramebuffer *target, UIRect rect, u32 color) {
+    u32 alpha = color >> 24;
+    if (alpha == 0) return;
+
+    for (s32 y = rect.y; y < rect.y + rect.h; y += 1) {
+        u32 *span = target->pixels + (s64)y * target->width + rect.x;
+
+        if (alpha == 255) fill_span(span, rect.w, color);
+        else              blend_span(span, rect.w, color);
+    }
+}
+
+// NOTE: Bilinear, x and y are 16.16 fixed point texel positions. Returns the distance in 8.8 fixed point.
+INTERNAL s32 sample_distance(UIRasterAtlas *atlas, s32 x, s32 y) {
+    s32 max = atlas->size - 1;
+
+    s32 x0 = x >> 16;
+    s32 y0 = y >> 16;
+    s32 fx = (x >> 8) & 0xFF;
+    s32 fy = (y >> 8) & 0xFF;
+
+    if (x0 < 0) { x0 = 0; fx = 0; }
+    if (y0 < 0) { y0 = 0; fy = 0; }
+    if (x0 >= max) { x0 = max; fx = 0; }
+    if (y0 >= max) { y0 = max; fy = 0; }
+
+    s32 x1 = x0 + (fx ? 1 : 0);
+    s32 y1 = y0 + (fy ? 1 : 0);
+
+    u8 const *row0 = atlas->data + (s64)y0 * atlas->size;
+    u8 const *row1 = atlas->data + (s64)y1 * atlas->size;
+
+    s32 top    = row0[x0] * (256 - fx) + row0[x1] * fx;
+    s32 bottom = row1[x0] * (256 - fx) + row1[x1] * fx;
+
+    return (top * (256 - fy) + bottom * fy) >> 8;
+}
+
+//===============================================
+// One screen pixel covers texels_per_pixel texels
+// of the atlas, so the distance changes by that
+// times scale from one pixel to the next. The
+// outline is smoothed over exactly one pixel.
+//===============================================
+INTERNAL void draw_glyph(UIFramebuffer *target, UIRect rect, UIQuad *quad, UIRasterAtlas *atlas) {
+    u32 color_alpha = quad->color >> 24;
+    if (color_alpha == 0) return;
+
+    r32 size = (r32)atlas->size;
+    r32 u0 = quad->u0 / 65535.0f * size;
+    r32 v0 = quad->v0 / 65535.0f * size;
+    r32 du = (quad->u1 - quad->u0) / 65535.0f * size / (r32)(quad->x1 - quad->x0);
+    r32 dv = (quad->v1 - quad->v0) / 65535.0f * size / (r32)(quad->y1 - quad->y0);
+
+    r32 texels_per_pixel = du > dv ? du : dv;
+    if (texels_per_pixel <= 0) return;
+
+    r32 coverage_scale = 255.0f / (texels_per_pixel * atlas->scale * 256.0f);
+    s32 edge = atlas->edge * 256;
+
+    // NOTE: Texel centers are at .5, the first sample is the center of the first pixel.
+    s32 step_x  = (s32)(du * 65536.0f);
+    s32 step_y  = (s32)(dv * 65536.0f);
+    s32 start_x = (s32)((u0 + (rect.x - quad->x0 + 0.5f) * du - 0.5f) * 65536.0f);
+    s32 start_y = (s32)((v0 + (rect.y - quad->y0 + 0.5f) * dv - 0.5f) * 65536.0f);
+
+    s32 ty = start_y;
+    for (s32 y = rect.y; y < rect.y + rect.h; y += 1) {
+        u32 *span = target->pixels + (s64)y * target->width + rect.x;
+
+        s32 tx = start_x;
+        for (s32 x = 0; x < rect.w; x += 1) {
+            s32 distance = sample_distance(atlas, tx, ty);
+            tx += step_x;
+
+            r32 coverage = (distance - edge) * coverage_scale + 127.5f;
+            if (coverage <= 0) continue;
+
+            u32 alpha = coverage >= 255 ? 255 : (u32)(coverage + 0.5f);
+            alpha = (alpha * color_alpha + 127) / 255;
+
+            span[x] = alpha == 255 ? quad->color : blend_pixel(span[x], quad->color, alpha);
+        }
+
+        ty += step_y;
+    }
+}
+
+INTERNAL UIRect intersect(UIRect a, UIRect b) {
+    s32 x0 = a.x > b.x ? a.x : b.x;
+    s32 y0 = a.y > b.y ? a.y : b.y;
+    s32 x1 = a.x + a.w < b.x + b.w ? a.x + a.w : b.x + b.w;
+    s32 y1 = a.y + a.h < b.y + b.h ? a.y + a.h : b.y + b.h;
+
+    UIRect result = {x0, y0, x1 - x0, y1 - y0};
+    if (result.w < 0) result.w = 0;
+    if (result.h < 0) result.h = 0;
+
+    return result;
+}
+
+INTERNAL UIRect quad_rect(UIQuad *quad) {
+    return {quad->x0, quad->y0, quad->x1 - quad->x0, quad->y1 - quad->y0};
+}
+
+
+//===============================================
+// Binning runs twice over the quads, first counting
+// the items per tile and then writing them at their
+// offsets, so every tile lists its quads in drawing
+// order without sorting.
+//===============================================
+INTERNAL void bin_quads(UIRasterizer *raster, UI *ui, b32 count_only) {
+    UIFramebuffer *target = raster->target;
+    UIRect screen = {0, 0, target->width, target->height};
+
+    s32 task_index = 0;
+    for (s64 w = -1; w < ui->windows.size; w += 1) {
+        UIWindow *window = w < 0 ? &ui->viewport : &ui->windows[w];
+
+        UIRect clip = screen;
+        FOR (window->tasks, task) {
+            if (task->kind == UI_TASK_CLIPPING) clip = intersect(screen, task->clipping.area);
+            if (task->kind != UI_TASK_GEOMETRY && task->kind != UI_TASK_TEXT) continue;
+
+            if (count_only) {
+                UIRasterTask raster_task = {task->kind, task->kind == UI_TASK_TEXT ? task->text.font_id : 0, clip};
+                append(&raster->tasks, raster_task);
+            }
+
+            for (s64 i = task->start; i < task->start + task->count; i += 1) {
+                UIRect rect = intersect(quad_rect(&raster->quads[i]), clip);
+                if (rect.w == 0 || rect.h == 0) continue;
+
+                s32 column_end = (rect.x + rect.w - 1) / UI_RASTER_TILE_SIZE;
+                s32 row_end    = (rect.y + rect.h - 1) / UI_RASTER_TILE_SIZE;
+
+                for (s32 row = rect.y / UI_RASTER_TILE_SIZE; row <= row_end; row += 1) {
+                    for (s32 column = rect.x / UI_RASTER_TILE_SIZE; column <= column_end; column += 1) {
+                        s32 tile = row * raster->tile_columns + column;
+
+                        if (count_only) {
+                            raster->tile_offsets[tile + 1] += 1;
+                        } else {
+                            UIRasterItem item = {task_index, (s32)i};
+                            raster->items[raster->tile_fill[tile]] = item;
+                            raster->tile_fill[tile] += 1;
+                        }
+                    }
+                }
+            }
+
+            task_index += 1;
+        }
+    }
+}
+
+INTERNAL void render_tile(void *context, s64 index) {
+    UIRasterizer *raster = (UIRasterizer*)context;
+    UIFramebuffer *target = raster->target;
+
+    s32 column = (s32)(index % raster->tile_columns);
+    s32 row    = (s32)(index / raster->tile_columns);
+
+    UIRect screen = {0, 0, target->width, target->height};
+    UIRect tile = {column * UI_RASTER_TILE_SIZE, row * UI_RASTER_TILE_SIZE, UI_RASTER_TILE_SIZE, UI_RASTER_TILE_SIZE};
+    tile = intersect(tile, screen);
+
+    for (s32 y = tile.y; y < tile.y + tile.h; y += 1) {
+        fill_span(target->pixels + (s64)y * target->width + tile.x, tile.w, raster->clear_color);
+    }
+
+    for (s32 i = raster->tile_offsets[index]; i < raster->tile_offsets[index + 1]; i += 1) {
+        UIRasterItem *item = &raster->items[i];
+        UIRasterTask *task = &raster->tasks[item->task];
+        UIQuad *quad = &raster->quads[item->quad];
+
+        UIRect rect = intersect(intersect(quad_rect(quad), task->clip), tile);
+        if (rect.w == 0 || rect.h == 0) continue;
+
+        if (task->kind == UI_TASK_GEOMETRY) {
+            draw_rect(target, rect, quad->color);
+        } else {
+            if (task->font_id < 0 || task->font_id >= raster->atlases.size) continue;
+
+            UIRasterAtlas *atlas = &raster->atlases[task->font_id];
+            if (!atlas->data || atlas->size < 2) continue;
+
+            draw_glyph(target, rect, quad, atlas);
+        }
+    }
+}
+
+void render(UIRasterizer *raster, UI *ui, UIFramebuffer *target, u32 clear_color) {
+    if (target->width <= 0 || target->height <= 0) return;
+
+    raster->target      = target;
+    raster->quads       = ui->quad_buffer.data;
+    raster->clear_color = clear_color;
+
+    raster->tile_columns = (target->width  + UI_RASTER_TILE_SIZE - 1) / UI_RASTER_TILE_SIZE;
+    raster->tile_rows    = (target->height + UI_RASTER_TILE_SIZE - 1) / UI_RASTER_TILE_SIZE;
+    s32 tile_count = raster->tile_columns * raster->tile_rows;
+
+    raster->tasks.size = 0;
+    prealloc(&raster->tile_offsets, tile_count + 1, raster->tile_offsets.allocator);
+    zero_memory(raster->tile_offsets.data, (tile_count + 1) * sizeof(s32));
+
+    bin_quads(raster, ui, true);
+
+    for (s32 i = 0; i < tile_count; i += 1) {
+        raster->tile_offsets[i + 1] += raster->tile_offsets[i];
+    }
+
+    prealloc(&raster->items, raster->tile_offsets[tile_count], raster->items.allocator);
+    prealloc(&raster->tile_fill, tile_count, raster->tile_fill.allocator);
+    copy_memory(raster->tile_fill.data, raster->tile_offsets.data, tile_count * sizeof(s32));
+
+    bin_quads(raster, ui, false);
+
+    if (ui->parallel_for && tile_count > 1) {
+        ui->parallel_for(ui->parallel_data, tile_count, render_tile, raster);
+    } else {
+        for (s32 i = 0; i < tile_count; i += 1) {
+            render_tile(raster, i);
+        }
+    }
+
+    raster->target = 0;
+    raster->quads  = 0;
+}
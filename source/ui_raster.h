@@ -0,0 +1,84 @@
+//================================================
+// Software renderer for the tasks of a UI, for
+// machines without a GPU and as a deterministic
+// target for rendering benchmarks. The output only
+// depends on the quads and the atlases, never on
+// the number of threads.
+//
+// The framebuffer is split into tiles and every
+// quad is sorted into the tiles it touches, keeping
+// the task order. The tiles are rendered on their
+// own, with UI::parallel_for if it is set. Rects
+// are filled four pixels at a time with SSE2 and
+// glyphs sample the distance field atlas of their
+// font.
+//
+// Usage after do_frame:
+//
+//   set_atlas(&raster, font_id, {font.atlas.data, font.atlas_size});
+//   render(&raster, &ui, &framebuffer, PACK_RGB(0, 0, 0));
+//================================================
+#pragma once
+
+#include "ui.h"
+
+
+#ifndef UI_RASTER_TILE_SIZE
+#define UI_RASTER_TILE_SIZE 64
+#endif
+
+// NOTE: Pixels are packed like the colors of the UI with PACK_RGBA, which is RGBA in memory.
+struct UIFramebuffer {
+    Allocator allocator;
+
+    u32 *pixels;
+    s32 width;
+    s32 height;
+};
+
+// NOTE: The values the Font atlas is generated with.
+s32 const UIRasterDefaultEdge  = 180;
+s32 const UIRasterDefaultScale = 36;
+
+// NOTE: A single channel distance field of size squared. The outline is at edge and a
+//       distance of one pixel at the size the glyphs were generated for is scale, 0 uses
+//       the defaults.
+struct UIRasterAtlas {
+    u8 const *data;
+    s32 size;
+
+    s32 edge;
+    s32 scale;
+};
+
+struct UIRasterTask;
+struct UIRasterItem;
+
+struct UIRasterizer {
+    List<UIRasterAtlas> atlases; // NOTE: Indexed by font id, atlases without data skip their text.
+
+    List<UIRasterTask> tasks;
+    List<UIRasterItem> items;
+    List<s32> tile_offsets;      // NOTE: The items of tile i are tile_offsets[i] up to tile_offsets[i + 1].
+    List<s32> tile_fill;
+
+    s32 tile_columns;
+    s32 tile_rows;
+
+    // NOTE: Only valid during render.
+    UIFramebuffer *target;
+    UIQuad *quads;
+    u32 clear_color;
+};
+
+void init(UIFramebuffer *framebuffer, s32 width, s32 height, Allocator alloc = DefaultAllocator);
+void destroy(UIFramebuffer *framebuffer);
+void resize(UIFramebuffer *framebuffer, s32 width, s32 height);
+
+void init(UIRasterizer *raster, Allocator alloc = DefaultAllocator);
+void destroy(UIRasterizer *raster);
+
+void set_atlas(UIRasterizer *raster, s32 font_id, UIRasterAtlas atlas);
+
+// NOTE: Clears the framebuffer to clear_color and draws the windows of the last frame.
+void render(UIRasterizer *raster, UI *ui, UIFramebuffer *target, u32 clear_color);
@@ -0,0 +1,262 @@
+#include "ui_replay.h"
+
+#include "platform.h"
+
+
+void init(UIRecorder *recorder, Allocator alloc) {
+    INIT_STRUCT(recorder);
+    init(&recorder->builder, alloc);
+
+    write_binary(&recorder->builder, UIRecordingIdentifier);
+    write_binary(&recorder->builder, UIRecordingVersion);
+}
+
+void destroy(UIRecorder *recorder) {
+    destroy(&recorder->builder);
+}
+
+INTERNAL u64 mouse_buttons(UserMouseInput *mouse) {
+    u64 buttons = 0;
+    for (s32 i = 0; i < MOUSE_KEY_COUNT; i += 1) {
+        if (mouse->keys[i]) buttons |= (u64)1 << i;
+    }
+
+    return buttons;
+}
+
+void record_frame(UIRecorder *recorder, V2i window_size, UserInput *input) {
+    UserMouseInput *mouse = &input->mouse;
+    UserMouseInput *last  = &recorder->mouse;
+
+    s32 toggled = 0;
+    for (s32 i = 0; i < KEY_CODE_COUNT; i += 1) {
+        if (!input->keyboard.keys[i] != !recorder->keyboard.keys[i]) toggled += 1;
+    }
+
+    u64 flags = 0;
+    if (window_size.w != recorder->size.w || window_size.h != recorder->size.h)     flags |= UI_RECORD_SIZE;
+    if (mouse->cursor_pos.x != last->cursor_pos.x || mouse->cursor_pos.y != last->cursor_pos.y) flags |= UI_RECORD_CURSOR;
+    if (mouse_buttons(mouse) != mouse_buttons(last)) flags |= UI_RECORD_BUTTONS;
+    if (mouse->scroll)         flags |= UI_RECORD_SCROLL;
+    if (input->actions.used)   flags |= UI_RECORD_ACTIONS;
+    if (toggled)               flags |= UI_RECORD_KEYBOARD;
+
+    StringBuilder *builder = &recorder->builder;
+    write_varint(builder, flags);
+
+    if (flags & UI_RECORD_SIZE) {
+        write_varint(builder, (u64)window_size.w);
+        write_varint(builder, (u64)window_size.h);
+    }
+    if (flags & UI_RECORD_CURSOR) {
+        write_varint_signed(builder, (s64)mouse->cursor_pos.x - last->cursor_pos.x);
+        write_varint_signed(builder, (s64)mouse->cursor_pos.y - last->cursor_pos.y);
+    }
+    if (flags & UI_RECORD_BUTTONS) write_varint(builder, mouse_buttons(mouse));
+    if (flags & UI_RECORD_SCROLL)  write_varint_signed(builder, mouse->scroll);
+
+    if (flags & UI_RECORD_ACTIONS) {
+        write_varint(builder, (u64)input->actions.used);
+
+        for (s32 i = 0; i < input->actions.used; i += 1) {
+            KeyAction *action = &input->actions.keys[i];
+
+            write_varint(builder, (u64)action->kind);
+            write_varint(builder, (u64)action->code);
+            write_varint(builder, (u64)action->code_point);
+        }
+    }
+
+    if (flags & UI_RECORD_KEYBOARD) {
+        write_varint(builder, (u64)toggled);
+
+        for (s32 i = 0; i < KEY_CODE_COUNT; i += 1) {
+            if (!input->keyboard.keys[i] != !recorder->keyboard.keys[i]) write_varint(builder, (u64)i);
+        }
+    }
+
+    recorder->size     = window_size;
+    recorder->mouse    = *mouse;
+    recorder->keyboard = input->keyboard;
+    recorder->frames  += 1;
+}
+
+b32 save_recording(UIRecorder *recorder, String file_name) {
+    PlatformFile file = platform_file_open(file_name, PlatformFileOverride);
+    if (!file.open) return false;
+
+    b32 written = write_builder_to_file(&recorder->builder, &file);
+    platform_file_close(&file);
+
+    return written;
+}
+
+
+b32 open_recording(UIPlayback *playback, String data) {
+    INIT_STRUCT(playback);
+    playback->reader = make_binary_reader(data);
+
+    u32 identifier = read_u32(&playback->reader);
+    u32 version    = read_u32(&playback->reader);
+
+    return !playback->reader.error && identifier == UIRecordingIdentifier && version == UIRecordingVersion;
+}
+
+b32 next_frame(UIPlayback *playback) {
+    BinaryReader *reader = &playback->reader;
+    if (remaining(reader) == 0) return false;
+
+    UserInput *input = &playback->input;
+    input->last_mouse   = input->mouse;
+    input->mouse.scroll = 0;
+    input->actions.used = 0;
+
+    u64 flags = read_varint(reader);
+
+    if (flags & UI_RECORD_SIZE) {
+        playback->size.w = (s32)read_varint(reader);
+        playback->size.h = (s32)read_varint(reader);
+    }
+
+    input->cursor_relative = {};
+    if (flags & UI_RECORD_CURSOR) {
+        input->cursor_relative.x = (s32)read_varint_signed(reader);
+        input->cursor_relative.y = (s32)read_varint_signed(reader);
+
+        input->mouse.cursor_pos.x += input->cursor_relative.x;
+        input->mouse.cursor_pos.y += input->cursor_relative.y;
+    }
+
+    if (flags & UI_RECORD_BUTTONS) {
+        u64 buttons = read_varint(reader);
+        for (s32 i = 0; i < MOUSE_KEY_COUNT; i += 1) {
+            input->mouse.keys[i] = (buttons >> i) & 1;
+        }
+    }
+    if (flags & UI_RECORD_SCROLL) input->mouse.scroll = (s32)read_varint_signed(reader);
+
+    if (flags & UI_RECORD_ACTIONS) {
+        u64 count = read_varint(reader);
+        if (count > (u64)MaxKeyActions) reader->error = true;
+
+        for (u64 i = 0; i < count && !reader->error; i += 1) {
+            KeyAction *action = &input->actions.keys[i];
+
+            action->kind       = (KeyActionKind)read_varint(reader);
+            action->code       = (KeyboardKeyCode)read_varint(reader);
+            action->code_point = (u32)read_varint(reader);
+
+            input->actions.used += 1;
+        }
+    }
+
+    if (flags & UI_RECORD_KEYBOARD) {
+        u64 count = read_varint(reader);
+
+        for (u64 i = 0; i < count && !reader->error; i += 1) {
+            u64 code = read_varint(reader);
+            if (code >= (u64)KEY_CODE_COUNT) {
+                reader->error = true;
+                break;
+            }
+
+            input->keyboard.keys[code] = !input->keyboard.keys[code];
+        }
+    }
+
+    if (reader->error) return false;
+
+    playback->frames += 1;
+
+    return true;
+}
+
+
+// NOTE: Shell sort, the timings of a recording are too many for an insertion sort.
+INTERNAL void sort_timings(s64 *timings, s64 count) {
+    s64 gap = 1;
+    while (gap < count / 3) gap = gap * 3 + 1;
+
+    for (; gap > 0; gap /= 3) {
+        for (s64 i = gap; i < count; i += 1) {
+            s64 value = timings[i];
+
+            s64 j = i;
+            for (; j >= gap && timings[j - gap] > value; j -= gap) {
+                timings[j] = timings[j - gap];
+            }
+            timings[j] = value;
+        }
+    }
+}
+
+b32 replay(UI *ui, String recording, UIReplayStats *stats, s32 repetitions) {
+    INIT_STRUCT(stats);
+
+    UIPlayback playback;
+    if (!open_recording(&playback, recording)) return false;
+
+    List<s64> timings = {};
+    init(&timings, 0);
+    DEFER(destroy(&timings));
+
+    s64 allocations     = ui->allocations;
+    s64 allocated_bytes = ui->allocated_bytes;
+
+    b32 error = false;
+    for (s32 repetition = 0; repetition < repetitions && !error; repetition += 1) {
+        if (!open_recording(&playback, recording)) break;
+
+        while (next_frame(&playback)) {
+            s64 start = platform_timestamp();
+            b32 changed = do_frame(ui, playback.size, &playback.input);
+            s64 stop  = platform_timestamp();
+
+            append(&timings, stop - start);
+
+            s64 tasks = ui->viewport.tasks.size;
+            FOR (ui->windows, window) {
+                tasks += window->tasks.size;
+            }
+
+            stats->frames += 1;
+            if (changed) stats->changed_frames += 1;
+
+            stats->quads += ui->quad_buffer.size;
+            stats->tasks += tasks;
+            if (ui->quad_buffer.size > stats->max_quads) stats->max_quads = ui->quad_buffer.size;
+            if (tasks > stats->max_tasks) stats->max_tasks = tasks;
+        }
+
+        error = playback.reader.error;
+    }
+
+    stats->allocations     = ui->allocations - allocations;
+    stats->allocated_bytes = ui->allocated_bytes - allocated_bytes;
+
+    if (timings.size) {
+        sort_timings(timings.data, timings.size);
+
+        s64 total = 0;
+        FOR (timings, timing) {
+            total += *timing;
+        }
+
+        stats->p50   = platform_in_milliseconds(timings[(timings.size - 1) * 50 / 100]);
+        stats->p99   = platform_in_milliseconds(timings[(timings.size - 1) * 99 / 100]);
+        stats->max   = platform_in_milliseconds(timings[-1]);
+        stats->total = platform_in_milliseconds(total);
+    }
+
+    return !error;
+}
+
+void print_replay_stats(UIReplayStats *stats) {
+    s64 frames = stats->frames ? stats->frames : 1;
+
+    print("frames:      %D (%D changed)\n", stats->frames, stats->changed_frames);
+    print("frame time:  p50 %f ms, p99 %f ms, max %f ms, total %f ms\n", stats->p50, stats->p99, stats->max, stats->total);
+    print("allocations: %D (%D per frame), %D bytes\n", stats->allocations, stats->allocations / frames, stats->allocated_bytes);
+    print("quads:       %D per frame, max %D\n", stats->quads / frames, stats->max_quads);
+    print("tasks:       %D per frame, max %D\n", stats->tasks / frames, stats->max_tasks);
+}
@@ -0,0 +1,112 @@
+//================================================
+// Recording the input of a UI and playing it back
+// without a window, to measure do_frame on the
+// exact same frames again and again.
+//
+// A recording is a header followed by one entry per
+// frame, everything but the header is varints and
+// only what changed since the last frame is stored:
+//
+//   header  u32 identifier, u32 version
+//   frame   varint flags (UIRecordFlags)
+//           window size          varint w, h
+//           cursor movement      signed varint dx, dy
+//           mouse keys           varint bit per key
+//           scroll               signed varint
+//           key actions          varint count, then kind, code, code_point
+//           toggled keys         varint count, then code
+//
+// last_mouse and cursor_relative are not stored,
+// the replay derives them from the last frame.
+//
+// Usage:
+//
+//   // Every frame of the application, before do_frame.
+//   record_frame(&recorder, window_size, &input);
+//   ...
+//   save_recording(&recorder, "session.uirec");
+//
+//   // Later, headless.
+//   UIReplayStats stats;
+//   if (replay(&ui, recording, &stats)) print_replay_stats(&stats);
+//================================================
+#pragma once
+
+#include "ui.h"
+#include "string_builder.h"
+#include "binary.h"
+
+
+u32 const UIRecordingIdentifier = 0x52495555; // NOTE: "UUIR"
+u32 const UIRecordingVersion    = 1;
+
+enum UIRecordFlags {
+    UI_RECORD_SIZE     = 0x01,
+    UI_RECORD_CURSOR   = 0x02,
+    UI_RECORD_BUTTONS  = 0x04,
+    UI_RECORD_SCROLL   = 0x08,
+    UI_RECORD_ACTIONS  = 0x10,
+    UI_RECORD_KEYBOARD = 0x20,
+};
+
+// NOTE: Must not be copied after init, the builder points into itself.
+struct UIRecorder {
+    StringBuilder builder;
+    s64 frames;
+
+    // NOTE: What the last recorded frame looked like, only the differences are written.
+    V2i size;
+    UserMouseInput mouse;
+    KeyboardState keyboard;
+};
+
+void init(UIRecorder *recorder, Allocator alloc = DefaultAllocator);
+void destroy(UIRecorder *recorder);
+
+void record_frame(UIRecorder *recorder, V2i window_size, UserInput *input);
+b32  save_recording(UIRecorder *recorder, String file_name);
+
+struct UIPlayback {
+    BinaryReader reader;
+    s64 frames;
+
+    V2i size;
+    UserInput input;
+};
+
+// NOTE: Returns false if data is no recording of a supported version.
+b32 open_recording(UIPlayback *playback, String data);
+// NOTE: Returns false at the end of the recording or if it is broken, check reader.error for the latter.
+b32 next_frame(UIPlayback *playback);
+
+
+//================================================
+// The replay runs every frame of a recording
+// through do_frame and measures it. Allocations
+// are taken from the counters of the UI, so only
+// what its containers allocate is included, not
+// the per frame arena it got at init and nothing
+// other threads allocate in the meantime.
+//================================================
+struct UIReplayStats {
+    s64 frames;
+    s64 changed_frames; // NOTE: do_frame said they have to be presented.
+
+    // NOTE: Of single frames, in milliseconds.
+    r64 p50;
+    r64 p99;
+    r64 max;
+    r64 total;
+
+    s64 allocations;
+    s64 allocated_bytes;
+
+    s64 quads;       // NOTE: Summed over all frames.
+    s64 tasks;
+    s64 max_quads;
+    s64 max_tasks;
+};
+
+// NOTE: The ui has to be initialized with its frame function already, repetitions > 1 plays the recording multiple times in a row.
+b32  replay(UI *ui, String recording, UIReplayStats *stats, s32 repetitions = 1);
+void print_replay_stats(UIReplayStats *stats);
@@ -594,6 +594,62 @@ UTF8CharResult utf8_peek(String str) {
     return result;
 }
 
+UTF8DecodeResult decode_utf8_block(String string, u32 *out, s64 cap) {
+    UTF8DecodeResult result = {};
+
+    u8 *in  = string.data;
+    u8 *last = string.data + string.size;
+    s64 written = 0;
+
+    while (written < cap && in < last) {
+        // NOTE: ASCII fast path. Mostly the whole block goes through here.
+        while (last - in >= 8 && cap - written >= 8) {
+            u8 mask = in[0] | in[1] | in[2] | in[3] | in[4] | in[5] | in[6] | in[7];
+            if (mask & 0x80) break;
+
+            for (s32 i = 0; i < 8; i += 1) {
+                out[written + i] = in[i];
+            }
+            in      += 8;
+            written += 8;
+        }
+        if (written == cap || in == last) break;
+
+        u8 c = in[0];
+        if (c < 0x80) {
+            out[written] = c;
+            written += 1;
+            in      += 1;
+
+            continue;
+        }
+
+        s32 length = utf8_length(c);
+        if (length == -1 || last - in < length) {
+            result.status = UTF_INVALID_SEQUENCE;
+            break;
+        }
+
+        u32 cp = 0;
+        if (length == 2) {
+            cp = ((in[0] & 0x1F) << 6) | (in[1] & 0x3F);
+        } else if (length == 3) {
+            cp = ((in[0] & 0x0F) << 12) | ((in[1] & 0x3F) << 6) | (in[2] & 0x3F);
+        } else {
+            cp = ((in[0] & 0x07) << 18) | ((in[1] & 0x3F) << 12) | ((in[2] & 0x3F) << 6) | (in[3] & 0x3F);
+        }
+
+        out[written] = cp;
+        written += 1;
+        in      += length;
+    }
+
+    result.count = written;
+    result.bytes = in - string.data;
+
+    return result;
+}
+
 u8 *next_utf8_sequence(String text, u8 *pos) {
     assert(pos >= begin(text) && pos <= end(text));
 
@@ -92,6 +92,22 @@ struct UTF8CharResult {
 };
 UTF8CharResult utf8_peek(String str);
 
+//===============================================
+// Decodes as many codepoints as fit into out.
+// Meant for hot loops where stepping with the
+// UTF8Iterator is too slow. Feed the rest of the
+// string (shrink_front by bytes) into the next call.
+// Decoding stops at an invalid or cut off sequence
+// with status set to UTF_INVALID_SEQUENCE.
+//===============================================
+s64 const UTF8DecodeBlockSize = 256;
+struct UTF8DecodeResult {
+    s64 count; // NOTE: Codepoints written.
+    s64 bytes; // NOTE: Bytes consumed.
+    UTFResult status;
+};
+UTF8DecodeResult decode_utf8_block(String string, u32 *out, s64 cap);
+
 u8 *next_utf8_sequence(String text, u8 *pos);
 u8 *previous_utf8_sequence(String text, u8 *pos);
 
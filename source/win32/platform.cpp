@@ -83,6 +83,15 @@ INTERNAL b32 setup_terminal() {
 
     return true;
 }
+
+// NOTE: Auto reset, platform_wakeup sets it and the wait resets it. Created once before the
+//       application runs, so any thread may wake up the main thread right away.
+INTERNAL void *WakeupEvent;
+INTERNAL b32 setup_wait() {
+    WakeupEvent = CreateEventW(0, false, false, 0);
+
+    return WakeupEvent != 0;
+}
 INTERNAL List<String> process_command_line() {
     wchar_t *cmd_line = GetCommandLineW();
 
@@ -114,6 +123,7 @@ INTERNAL int main_main() {
 
     if (!setup_raw_input()) return -1;
     if (!setup_terminal())  return -1;
+    setup_wait();
     change_log_file(Console.out);
 
     List<String> args = process_command_line();
@@ -601,7 +611,7 @@ b32 platform_rename_file(String from, String to) {
     WideString wide_from = widen_path(from);
     WideString wide_to   = widen_path(to);
 
-    return MoveFileW(wide_from.data, wide_to.data);
+    return MoveFileExW(wide_from.data, wide_to.data, MOVEFILE_REPLACE_EXISTING);
 }
 
 String platform_line_ending() {
@@ -717,6 +727,104 @@ PlatformReadResult platform_read_entire_file(String file, Allocator alloc) {
 }
 
 
+PlatformMappedFile platform_map_entire_file(String file) {
+    SCOPE_TEMP_STORAGE();
+
+    PlatformMappedFile result = {};
+
+    WideString wide_file = widen_path(file);
+    void *handle = CreateFileW(wide_file.data, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (handle == INVALID_HANDLE_VALUE) {
+        if (GetLastError() == ERROR_FILE_NOT_FOUND) {
+            result.error = PLATFORM_FILE_NOT_FOUND;
+        } else {
+            result.error = PLATFORM_READ_ERROR;
+        }
+
+        return result;
+    }
+    DEFER(CloseHandle(handle));
+
+    s64 size;
+    GetFileSizeEx(handle, &size);
+    if (size == 0) return result;
+
+    // NOTE: The view keeps the mapping alive, so both handles can be closed right away.
+    void *mapping = CreateFileMappingW(handle, 0, PAGE_READONLY, 0, 0, 0);
+    if (mapping == 0) {
+        result.error = PLATFORM_READ_ERROR;
+        return result;
+    }
+    DEFER(CloseHandle(mapping));
+
+    void *memory = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (memory == 0) {
+        result.error = PLATFORM_READ_ERROR;
+        return result;
+    }
+
+    result.content = {(u8*)memory, size};
+    result.handle  = memory;
+
+    return result;
+}
+
+void platform_unmap_file(PlatformMappedFile *file) {
+    if (file->handle) UnmapViewOfFile(file->handle);
+
+    INIT_STRUCT(file);
+}
+
+
+// NOTE: Polls the last write time. FindFirstChangeNotificationW only works on
+//       whole folders and would still need this check to filter the file.
+struct PlatformFileWatcher {
+    Allocator allocator;
+
+    WideString path;
+    FILETIME last_write_time;
+};
+
+INTERNAL FILETIME last_write_time(WideString path) {
+    FILETIME result = {};
+
+    WIN32_FIND_DATAW find_data = {};
+    void *handle = FindFirstFileW(path.data, &find_data);
+    if (handle != INVALID_HANDLE_VALUE) {
+        result = find_data.last_write_time;
+        FindClose(handle);
+    }
+
+    return result;
+}
+
+PlatformFileWatcher *platform_watch_file(String file, Allocator alloc) {
+    PlatformFileWatcher *watcher = ALLOC(alloc, PlatformFileWatcher, 1);
+    watcher->allocator = alloc;
+    watcher->path = widen_path(file, alloc);
+    watcher->last_write_time = last_write_time(watcher->path);
+
+    return watcher;
+}
+
+void platform_unwatch_file(PlatformFileWatcher *watcher) {
+    if (!watcher) return;
+
+    Allocator alloc = watcher->allocator;
+    DEALLOC(alloc, watcher->path.data, watcher->path.size);
+    DEALLOC(alloc, watcher, 1);
+}
+
+b32 platform_file_changed(PlatformFileWatcher *watcher) {
+    FILETIME time = last_write_time(watcher->path);
+
+    b32 changed = time.low_date_time != watcher->last_write_time.low_date_time || time.high_date_time != watcher->last_write_time.high_date_time;
+    watcher->last_write_time = time;
+
+    return changed;
+}
+
+
 b32 platform_file_exists(String file) {
     WideString wide_file = widen_path(file);
 
@@ -735,6 +843,38 @@ r64 platform_in_milliseconds(s64 timestamp) {
     return (r64)timestamp / QPCFrequency;
 }
 
+s64 platform_from_milliseconds(r64 milliseconds) {
+    return (s64)(milliseconds * QPCFrequency / 1000.0);
+}
+
+// NOTE: Sleep alone is only as precise as the timer resolution, 15.6ms by default.
+//       The high resolution waitable timer (Windows 10 1803+) is used if available.
+INTERNAL void *SleepTimer;
+INTERNAL b32   SleepTimerCreated;
+
+void platform_sleep_until(s64 timestamp) {
+    s64 wake = timestamp - QPCFrequency * PLATFORM_SLEEP_SPIN_MICROSECONDS / 1000000;
+    s64 remaining = wake - platform_timestamp();
+
+    if (remaining > 0) {
+        if (!SleepTimerCreated) {
+            SleepTimer = CreateWaitableTimerExW(0, 0, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+            SleepTimerCreated = true;
+        }
+
+        if (SleepTimer) {
+            // NOTE: Negative is relative, in 100 nanosecond steps.
+            s64 due = -(remaining * 10000000 / QPCFrequency);
+            SetWaitableTimer(SleepTimer, &due, 0, 0, 0, false);
+            WaitForSingleObject(SleepTimer, INFINITE);
+        } else {
+            Sleep((u32)(remaining * 1000 / QPCFrequency));
+        }
+    }
+
+    while (platform_timestamp() < timestamp);
+}
+
 
 u32 const STACK_TRACE_SIZE = 64;
 u32 const SYMBOL_NAME_LENGTH = 1024;
@@ -836,6 +976,26 @@ void platform_update() {
     LastTime = time;
 }
 
+PlatformWakeReason platform_wait_for_update(s64 timeout_ms) {
+    u32 timeout = timeout_ms < 0 ? INFINITE : (timeout_ms >= INFINITE ? INFINITE - 1 : (u32)timeout_ms);
+    u32 count   = WakeupEvent ? 1 : 0;
+
+    // NOTE: MWMO_INPUTAVAILABLE returns for messages that are already queued, too.
+    u32 result = MsgWaitForMultipleObjectsEx(count, &WakeupEvent, timeout, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+
+    PlatformWakeReason reason = PLATFORM_WAKE_INPUT;
+    if (result == WAIT_TIMEOUT)               reason = PLATFORM_WAKE_TIMEOUT;
+    else if (count && result == WAIT_OBJECT_0) reason = PLATFORM_WAKE_USER;
+
+    platform_update();
+
+    return reason;
+}
+
+void platform_wakeup() {
+    if (WakeupEvent) SetEvent(WakeupEvent);
+}
+
 INTERNAL sPtr CALLBACK main_window_callback(HWND window, u32 msg, uPtr w_param, sPtr l_param);
 
 INTERNAL b32 WindowClassRegistered;
@@ -242,6 +242,23 @@ WIN32_FUNC_DEF(b32) PeekMessageW(MSG *msg, HWND wnd, u32 msg_filter_min, u32 msg
 WIN32_FUNC_DEF(b32) TranslateMessage(MSG const *msg);
 WIN32_FUNC_DEF(s32) DispatchMessageW(MSG const *msg);
 
+// MsgWaitForMultipleObjectsEx
+u32 const QS_ALLINPUT         = 0x04FF;
+u32 const MWMO_INPUTAVAILABLE = 0x0004;
+u32 const WAIT_OBJECT_0       = 0x00000000;
+u32 const WAIT_TIMEOUT        = 0x00000102;
+WIN32_FUNC_DEF(u32) MsgWaitForMultipleObjectsEx(u32 count, void * const *handles, u32 milliseconds, u32 wake_mask, u32 flags);
+
+WIN32_FUNC_DEF(void*) CreateEventW(void *event_attributes, b32 manual_reset, b32 initial_state, wchar_t const *name);
+WIN32_FUNC_DEF(b32)   SetEvent(void *event);
+
+// CreateWaitableTimerExW
+u32 const CREATE_WAITABLE_TIMER_HIGH_RESOLUTION = 0x00000002;
+u32 const TIMER_ALL_ACCESS = 0x001F0003;
+WIN32_FUNC_DEF(void*) CreateWaitableTimerExW(void *timer_attributes, wchar_t const *timer_name, u32 flags, u32 desired_access);
+WIN32_FUNC_DEF(b32)   SetWaitableTimer(void *timer, s64 const *due_time, s32 period, void *completion_routine, void *arg, b32 resume);
+WIN32_FUNC_DEF(void)  Sleep(u32 milliseconds);
+
 
 WIN32_FUNC_DEF(HMODULE) LoadLibraryW(wchar_t const *lib_file_name);
 WIN32_FUNC_DEF(b32)     FreeLibrary(HMODULE lib_module);
@@ -293,6 +310,14 @@ u32 const FILE_ATTRIBUTE_NORMAL    = 0x00000080;
 u32 const ERROR_FILE_NOT_FOUND = 0x02;
 WIN32_FUNC_DEF(void*) CreateFileW(wchar_t *file_name, u32 desired_access, u32 share_mode, SECURITY_ATTRIBUTES *security_attributes, u32 creation_disposition, u32 flags_and_attributes, void *template_file);
 
+// CreateFileMappingW
+u32 const FILE_SHARE_READ = 0x00000001;
+u32 const PAGE_READONLY   = 0x02;
+u32 const FILE_MAP_READ   = 0x0004;
+WIN32_FUNC_DEF(void*) CreateFileMappingW(void *file, SECURITY_ATTRIBUTES *attributes, u32 protect, u32 maximum_size_high, u32 maximum_size_low, wchar_t const *name);
+WIN32_FUNC_DEF(void*) MapViewOfFile(void *file_mapping_object, u32 desired_access, u32 file_offset_high, u32 file_offset_low, uPtr number_of_bytes_to_map);
+WIN32_FUNC_DEF(b32)   UnmapViewOfFile(void const *base_address);
+
 WIN32_FUNC_DEF(b32) ReadFile(void *file, void *buffer, u32 number_of_bytes_to_read, u32 *number_of_bytes_read, OVERLAPPED *overlapped);
 WIN32_FUNC_DEF(b32) WriteFile(void *file, void const*buffer, u32 number_of_bytes_to_write, u32 *number_of_bytes_written, OVERLAPPED *overlapped);
 